@@ -1,3 +1,4 @@
+#include "../../physicsCore/includes/random.hpp"
 #include "../extLibs/glad/glad.h"
 #include "shader.hpp"
 #include <cmath>
@@ -9,43 +10,17 @@ private:
   unsigned int vbo;
 
 public:
-  // physics params
-  glm::vec2 velocity;
-  float mass;
+  // ball only renders, the physics state lives in physicsCore's
+  // ParticleState and main copies centers over before drawing
 
   // ball params
   glm::vec2 center;
   glm::vec3 color;
   float radius;
+  float scale{1.0f};
   const int numSegments;
   std::vector<float> vertices;
 
-  void updatePhysics(float dt, float halfWidth, float halfHeight) {
-    center += velocity * dt;
-    CollisionCheck(halfWidth, halfHeight);
-  }
-  // wall collision check
-  void CollisionCheck(const float halfWidth, const float halfHeight) {
-    float right_boundary = halfWidth;
-    float left_boundary = -halfWidth;
-    float top_boundary = halfHeight;
-    float bottom_boundary = -halfHeight;
-
-    if (center.x + radius >= right_boundary) {
-      center.x = right_boundary - radius;
-      velocity.x = -fabs(velocity.x);
-    } else if (center.x - radius <= left_boundary) {
-      center.x = left_boundary + radius;
-      velocity.x = fabs(velocity.x);
-    }
-    if (center.y + radius >= top_boundary) {
-      center.y = top_boundary - radius;
-      velocity.y = -fabs(velocity.y);
-    } else if (center.y - radius <= bottom_boundary) {
-      center.y = bottom_boundary + radius;
-      velocity.y = fabs(velocity.y);
-    }
-  }
   // draw a ball
   void draw(Shader &shader) {
     // shader.use();// to improve efficiency and call it each time for each ball
@@ -53,15 +28,16 @@ public:
     shader.setVec3("color", color);
     glm::mat4 model = glm::mat4(1.0f);
     model = glm::translate(model, glm::vec3(center.x, center.y, 0.0f));
+    model = glm::scale(model, glm::vec3(scale, scale, 1.0f));
     shader.setMat4("model", glm::value_ptr(model));
     glBindVertexArray(this->vao);
     glDrawArrays(GL_TRIANGLE_FAN, 0, this->numSegments + 2);
     glBindVertexArray(0);
   }
   // generate a ball
-  Ball(float mass = 5.0f, float radius = 25.0f, int numSegments = 32,
+  Ball(float radius = 25.0f, int numSegments = 32,
        glm::vec2 center = {0.0f, 0.0f})
-      : radius(radius), numSegments(numSegments), center(center), mass(mass) {
+      : radius(radius), numSegments(numSegments), center(center) {
     vertices.clear();
     vertices.reserve((numSegments + 2) * 2);
 
@@ -89,29 +65,17 @@ public:
     glEnableVertexAttribArray(0);
     glBindVertexArray(0);
   }
-  float randFloat(float a, float b) {
-    return a + (b - a) * (static_cast<float>(rand()) / RAND_MAX);
-  }
-  void setRandVelocity() {
-    velocity.x = (rand() % 2 == 0 ? 1 : -1) * randFloat(75.0f, 250.0f);
-    velocity.y = (rand() % 2 == 0 ? 1 : -1) * randFloat(150.0f, 250.0f);
-  }
-  void setRandCenter() {
-    center.x = (rand() % 2 == 0 ? 1 : -1) * randFloat(0.0f, 360.0f);
-    center.y = (rand() % 2 == 0 ? 1 : -1) * randFloat(0.0f, 260.0f);
-  }
-  void setRandColor() {
-    color.x = randFloat(0.0f, 1.0f);
-    color.y = randFloat(0.0f, 1.0f);
-    color.z = randFloat(0.0f, 1.0f);
-  }
-  void setRandMass() { mass = randFloat(5.0f, 100.0f); }
-  void setRandParameters() {
-    setRandCenter();
-    setRandVelocity();
-    setRandColor();
-    setRandMass();
+  // what setRandColor picks, for balls that share one mesh
+  static glm::vec3 randomColor(RandomStream &rng) {
+    glm::vec3 c;
+    c.x = rng.uniform(0.0f, 1.0f);
+    c.y = rng.uniform(0.0f, 1.0f);
+    c.z = rng.uniform(0.0f, 1.0f);
+    return c;
   }
+  void setRandColor(RandomStream &rng) { color = randomColor(rng); }
+  // the mesh is built at the constructor radius, scale it to a sim radius
+  void setDrawRadius(float r) { scale = r / radius; }
   ~Ball() {
     glDeleteBuffers(1, &vbo);
     glDeleteVertexArrays(1, &vao);
@@ -1,3 +1,10 @@
+#include "../physicsCore/includes/cellGrid.hpp"
+#include "../physicsCore/includes/kernels.hpp"
+#include "../physicsCore/includes/particlePool.hpp"
+#include "../physicsCore/includes/replay.hpp"
+#include "../physicsCore/includes/scenario.hpp"
+#include "../physicsCore/includes/spawn.hpp"
+#include "../physicsCore/includes/trace.hpp"
 #include "includes/ball.hpp"
 #include "includes/window.hpp"
 #include <GLFW/glfw3.h>
@@ -10,78 +17,209 @@
 const unsigned int WIDTH = 800;
 const unsigned int HEIGHT = 600;
 
-void ballCollision(std::vector<std::unique_ptr<Ball>> &balls);
+using Particles = ParticleState<2, float>;
 
-int main() {
+int main(int argc, char **argv) {
+  auto launched = std::chrono::steady_clock::now();
   const float halfWidth = static_cast<float>(WIDTH) / 2;
   const float halfHeight = static_cast<float>(HEIGHT) / 2;
 
-  srand(static_cast<unsigned int>(time(0)));
+  const uint64_t seed = seedFromArgs(argc, argv);
+  std::cout << "seed " << seed << std::endl;
+
+  // --replay file plays a recording instead of simulating, --record file
+  // writes one as the simulation runs
+  const char *replayPath = argValue(argc, argv, "--replay");
+  const char *recordPath = argValue(argc, argv, "--record");
+  // --trace file writes the timing zones of the frame loop at exit
+  const char *tracePath = argValue(argc, argv, "--trace");
+  requireTraceZones(tracePath);
+  // --present vsync, uncapped or a frame rate to pace to
+  const PresentSettings present =
+      presentSettingsFrom(argValue(argc, argv, "--present"));
+
+  // the built in scene, --scenario file overrides what the file mentions
+  Scenario setup;
+  setup.dim = 2;
+  setup.count = 20;
+  setup.halfExtent[0] = halfWidth;
+  setup.halfExtent[1] = halfHeight;
+  setup.spawnExtent[0] = 360.0;
+  setup.spawnExtent[1] = 260.0;
+  setup.speedMin[0] = 75.0;
+  setup.speedMax[0] = 250.0;
+  setup.speedMin[1] = 150.0;
+  setup.speedMax[1] = 250.0;
+  setup.radiusMin = setup.radiusMax = 25.0;
+  setup.gravity[1] = 0.0;
+  if (const char *scenarioPath = argValue(argc, argv, "--scenario")) {
+    setup = loadScenario(scenarioPath, setup);
+  }
+  std::unique_ptr<ReplayPlayer<2, float>> player;
+  if (replayPath) {
+    player = std::make_unique<ReplayPlayer<2, float>>(replayPath);
+    std::cout << "replaying " << player->frameCount() << " frames, P pauses, "
+              << "LEFT/RIGHT scrub, HOME/END jump" << std::endl;
+  }
 
   Window window(WIDTH, HEIGHT, "GL bouncing ball");
+  window.setPresentMode(present);
 
+  // builds while the meshes are set up, waited on at the first use()
+  ShaderBuilder shaderBuilder(window.getWindow());
   Shader ballShader("shaders/ball.vert", "shaders/ball.frag");
 
+  SceneParams<2, float> scene = sceneOf<2, float>(setup);
+  SpawnRanges<2, float> ranges = rangesOf<2, float>(setup);
+
+  // [NOTE] -> a very interesting issue indeed
+  // see notion toggleList Misc.->[bounceBall proj.]to see why i am using this
   glm::mat4 projection =
-      glm::ortho(-halfWidth, halfWidth, -halfHeight, halfHeight, -1.0f, 1.0f);
+      glm::ortho(-scene.halfExtent[0], scene.halfExtent[0],
+                 -scene.halfExtent[1], scene.halfExtent[1], -1.0f, 1.0f);
+
+  JobSystem jobs;
+  CellGrid<2, float> grid;
+  // room for the balls E emits, X sinks them again
+  ParticlePool<2, float> pool(setup.count + 4096);
+  {
+    Particles spawned;
+    spawnRandom(spawned, ranges, setup.count, seed);
+    for (size_t i = 0; i < spawned.size(); ++i) {
+      pool.spawnCopy(spawned, i);
+    }
+  }
+  Particles &particles = pool.state();
+  RandomStream emitter(seed, firstFreeStream + 1);
+  const float emitRate = 240.0f; // balls per second
+  float emitDue = 0.0f;
+  if (!player) {
+    std::cout << "hold E to emit balls, X to sink the ones on the floor"
+              << (recordPath ? " (off while recording)" : "") << std::endl;
+  }
+
+  // one disc draws every ball and a ball keeps only a color by slot, so
+  // spawning takes no GL call and no allocation
+  Ball disc(25.0f);
+  RandomStream colors(seed, firstFreeStream);
+  std::vector<glm::vec3> ballColors(pool.capacity());
+  for (glm::vec3 &c : ballColors) {
+    c = Ball::randomColor(colors);
+  }
 
   ballShader.use();
   ballShader.setMat4("projection", glm::value_ptr(projection));
 
-  // [NOTE] -> a very interesting issue indeed
-  // see notion toggleList Misc.->[bounceBall proj.]to see why i am using this
-  std::vector<std::unique_ptr<Ball>> balls;
-  balls.reserve(100);
-  for (int i = 0; i < 20; ++i) {
-    auto b = std::make_unique<Ball>();
-    b->setRandParameters();
-    balls.push_back(std::move(b));
+  std::unique_ptr<TrajectoryRecorder<2, float>> recorder;
+  if (recordPath) {
+    recorder = std::make_unique<TrajectoryRecorder<2, float>>(recordPath, scene);
   }
+  uint64_t step = 0;
+  ReplayClock clock;
+  ReplayKeys replayKeys;
 
+  bool firstFrame = true;
   while (!window.shouldClose()) {
-    window.processInput();
+    {
+      TRACE_ZONE("input");
+      window.processInput();
+    }
 
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
+    {
+      TRACE_ZONE("clear");
+      glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+      glClear(GL_COLOR_BUFFER_BIT);
+    }
 
     static double lastTime = glfwGetTime();
     double currentTime = glfwGetTime();
     float dt = static_cast<float>(currentTime - lastTime);
     lastTime = currentTime;
 
-    ballCollision(balls);
+    if (player) {
+      player->seek(replayKeys.update(window.getWindow(), clock, dt,
+                                     player->frameCount()));
+    } else {
+      // a recording expects a fixed set of balls
+      GLFWwindow *w = window.getWindow();
+      if (!recorder && glfwGetKey(w, GLFW_KEY_E) == GLFW_PRESS) {
+        for (emitDue += emitRate * dt; emitDue >= 1.0f && !pool.full();
+             emitDue -= 1.0f) {
+          const float p[2] = {emitter.uniform(-20.0f, 20.0f),
+                              scene.halfExtent[1] - 30.0f};
+          const float v[2] = {emitter.uniform(-150.0f, 150.0f),
+                              emitter.uniform(-250.0f, -50.0f)};
+          const float r = emitter.uniform(static_cast<float>(setup.radiusMin),
+                                          static_cast<float>(setup.radiusMax));
+          const float m = emitter.uniform(static_cast<float>(setup.massMin),
+                                          static_cast<float>(setup.massMax));
+          ballColors[pool.spawn(p, v, r, m).slot] = Ball::randomColor(colors);
+        }
+        emitDue = std::min(emitDue, 1.0f);
+      }
+      if (!recorder && glfwGetKey(w, GLFW_KEY_X) == GLFW_PRESS) {
+        for (size_t i = particles.size(); i-- > 0;) {
+          if (particles.pos[1][i] - particles.radius[i] <=
+              1.0f - scene.halfExtent[1]) {
+            pool.destroyAt(i);
+          }
+        }
+      }
+      {
+        TRACE_ZONE("collisions");
+        grid.build(jobs, particles, scene);
+        grid.ballCollisions(particles, scene);
+      }
+      {
+        TRACE_ZONE("physics");
+        updatePhysics(jobs, particles, scene, dt);
+      }
+      if (recorder) {
+        recorder->record(particles, ++step);
+      }
+    }
 
-    for (auto &b : balls) {
-      b->updatePhysics(dt, halfWidth, halfHeight);
-      b->draw(ballShader);
+    // the grid reorders the state, id maps a ball back to its color; a
+    // replay larger than the pool gets more colors on the first frame
+    {
+      TRACE_ZONE("draw");
+      const Particles &drawn = player ? player->read().state : particles;
+      while (ballColors.size() < drawn.size()) {
+        ballColors.push_back(Ball::randomColor(colors));
+      }
+      for (size_t i = 0; i < drawn.size(); ++i) {
+        disc.color = ballColors[drawn.id[i]];
+        disc.setDrawRadius(drawn.radius[i]);
+        disc.center = glm::vec2(drawn.pos[0][i], drawn.pos[1][i]);
+        disc.draw(ballShader);
+      }
     }
 
-    window.swapBuffersAndPollEvents();
+    {
+      TRACE_ZONE("swap");
+      window.swapBuffersAndPollEvents();
+    }
+    if (firstFrame) {
+      firstFrame = false;
+      Shader::reportStartup(std::cout);
+      std::cout << "first frame after "
+                << std::chrono::duration<double, std::milli>(
+                       std::chrono::steady_clock::now() - launched)
+                       .count()
+                << " ms" << std::endl;
+    }
   }
 
-  glfwTerminate();
-  return 0;
-}
-
-void ballCollision(std::vector<std::unique_ptr<Ball>> &balls) {
-  for (size_t i = 0; i < balls.size(); ++i) {
-    for (size_t j = i + 1; j < balls.size(); ++j) {
-      glm::vec2 delta = balls[j]->center - balls[i]->center;
-      float dist = glm::length(delta);
-      if (dist < balls[i]->radius + balls[j]->radius) {
-        glm::vec2 normal = delta / dist;
-
-        float p = 2.0f *
-                  glm::dot(balls[i]->velocity - balls[j]->velocity, normal) /
-                  (balls[i]->mass + balls[j]->mass);
-
-        balls[i]->velocity -= p * balls[j]->mass * normal;
-        balls[j]->velocity += p * balls[i]->mass * normal;
-
-        float overlap = balls[i]->radius + balls[j]->radius - dist;
-        balls[i]->center -= normal * (overlap / 2.0f);
-        balls[j]->center += normal * (overlap / 2.0f);
-      }
-    }
+  jobs.printStats(std::cout);
+  window.frameStats().report(std::cout, window.presentMode());
+  if (recorder) {
+    recorder->drain();
+    recorder->report(std::cout);
   }
+  if (tracePath) {
+    Trace::instance().write(tracePath);
+    std::cout << Trace::instance().zones() << " zones traced to " << tracePath
+              << std::endl;
+  }
+  return 0;
 }
@@ -1,9 +1,8 @@
 #pragma once
+#include "../../physicsCore/includes/random.hpp"
 #include "../extLibs/glad/glad.h"
 #include "shader.hpp"
 #include <cmath>
-#include <cstdlib>
-#include <ctime>
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -15,13 +14,10 @@ private:
   unsigned int vao{}, vbo{}, ebo{};
 
 public:
-  // Physics params
-  glm::vec3 velocity{50.0f};
-  float mass{5.0f};
+  // Ball only renders, the physics state lives in physicsCore's
+  // ParticleState and main copies centers over before drawing
   glm::vec3 rotationAngle{0.0f};
   glm::vec3 scaleFactor{1.0f};
-  glm::vec3 gravity{0.0f, -9.8f, 0.0f};
-  float dampingCoeff{0.99f};
 
   // Rendering params
   glm::vec3 center{0.0f};
@@ -31,80 +27,16 @@ public:
   int stackCount{18};
   size_t indexCount{0};
 
-  Ball(float radius = 5.0f, float mass = 5.0f, int sectorCount = 36,
-       int stackCount = 18, glm::vec3 center = {0.0f, 0.0f, 0.0f})
+  Ball(float radius = 5.0f, int sectorCount = 36, int stackCount = 18,
+       glm::vec3 center = {0.0f, 0.0f, 0.0f})
       : radius(radius), center(center), sectorCount(sectorCount),
-        stackCount(stackCount), mass(mass) {
+        stackCount(stackCount) {
     generateSphere();
   }
 
-  // Update physics
-  void updatePhysics(float dt, float halfWidth, float halfHeight,
-                     float halfDepth) {
-    velocity += gravity * dt;
-    center += velocity * dt;
-    CollisionCheck(halfWidth, halfHeight, halfDepth);
-  }
-
-  // Wall collision
-  void CollisionCheck(const float halfWidth, const float halfHeight,
-                      const float halfDepth) {
-    // X-axis bounce
-    if (center.x + radius > halfWidth) {
-      center.x = halfWidth - radius;
-      velocity.x *= -dampingCoeff;
-    } else if (center.x - radius < -halfWidth) {
-      center.x = -halfWidth + radius;
-      velocity.x *= -dampingCoeff;
-    }
-
-    // Y-axis bounce
-    if (center.y + radius > halfHeight) {
-      center.y = halfHeight - radius;
-      velocity.y *= -dampingCoeff;
-    } else if (center.y - radius < -halfHeight) {
-      center.y = -halfHeight + radius;
-      velocity.y *= -dampingCoeff;
-    }
-
-    // Z-axis bounce
-    if (center.z + radius > halfDepth) {
-      center.z = halfDepth - radius;
-      velocity.z *= -dampingCoeff;
-    } else if (center.z - radius < -halfDepth) {
-      center.z = -halfDepth + radius;
-      velocity.z *= -dampingCoeff;
-    }
-  }
-
-  bool ballCollisions(Ball &other) {
-    glm::vec3 delta = other.center - center;
-    float dist = glm::length(delta);
-    float sumR = radius + other.radius;
-
-    if (dist < sumR && dist > 1e-4f) {
-      glm::vec3 normal = glm::normalize(delta);
-      float overlap = sumR - dist;
-
-      center -= normal * (overlap * 0.5f);
-      other.center += normal * (overlap * 0.5f);
-
-      glm::vec3 relVel = velocity - other.velocity;
-      float velAlongNormal = glm::dot(relVel, normal);
-      if (velAlongNormal > 0.0f)
-        return 0;
+  // the mesh is built at the constructor radius, scale it to a sim radius
+  void setDrawRadius(float r) { scaleFactor = glm::vec3(r / radius); }
 
-      float e = 0.99f;
-      float j = -(1 + e) * velAlongNormal;
-      j /= (1.0f / mass + 1.0f / other.mass);
-
-      glm::vec3 impulse = j * normal;
-      velocity += impulse / mass;
-      other.velocity -= impulse / other.mass;
-      return true;
-    }
-    return false;
-  }
   // Draw sphere
   void draw(Shader &shader) {
     shader.use();
@@ -231,38 +163,15 @@ public:
     glBindVertexArray(0);
   }
 
-  float randFloat(float a, float b) {
-    return a + (b - a) * (static_cast<float>(rand()) / RAND_MAX);
-  }
-
-  void setRandVelocity() {
-    velocity.x = (rand() % 2 == 0 ? 1 : -1) * randFloat(45.0f, 70.0f);
-    velocity.y = (rand() % 2 == 0 ? 1 : -1) * randFloat(45.0f, 70.0f);
-    velocity.z = (rand() % 2 == 0 ? 1 : -1) * randFloat(45.0f, 70.0f);
-  }
-
-  void setRandCenter(float halfSize) {
-    center.x = randFloat(-halfSize, halfSize);
-    center.y = randFloat(-halfSize, halfSize);
-    center.z = randFloat(-halfSize, halfSize);
-  }
-
-  void setRandColor() {
-    color.x = randFloat(0.0f, 1.0f);
-    color.y = randFloat(0.0f, 1.0f);
-    color.z = randFloat(0.0f, 1.0f);
-  }
-
-  void setRandMass() { mass = randFloat(5.0f, 100.0f); }
-  void setRandRadius() { radius = randFloat(5.0f, 25.0f); }
-
-  void setRandParameters(float halfSize) {
-    setRandCenter(halfSize);
-    setRandVelocity();
-    setRandColor();
-    setRandRadius();
-    setRandMass();
+  // what setRandColor picks, for balls that share one mesh
+  static glm::vec3 randomColor(RandomStream &rng) {
+    glm::vec3 c;
+    c.x = rng.uniform(0.0f, 1.0f);
+    c.y = rng.uniform(0.0f, 1.0f);
+    c.z = rng.uniform(0.0f, 1.0f);
+    return c;
   }
+  void setRandColor(RandomStream &rng) { color = randomColor(rng); }
 
   ~Ball() {
     glDeleteBuffers(1, &vbo);
@@ -1,3 +1,15 @@
+#include "../physicsCore/includes/cellGrid.hpp"
+#include "../physicsCore/includes/collisionLog.hpp"
+#include "../physicsCore/includes/culling.hpp"
+#include "../physicsCore/includes/kernels.hpp"
+#include "../physicsCore/includes/pipeline.hpp"
+#include "../physicsCore/includes/replay.hpp"
+#include "../physicsCore/includes/rewind.hpp"
+#include "../physicsCore/includes/scenario.hpp"
+#include "../physicsCore/includes/stats.hpp"
+#include "../physicsCore/includes/spawn.hpp"
+#include "../physicsCore/includes/telemetry.hpp"
+#include "../physicsCore/includes/trace.hpp"
 #include "includes/ball.hpp"
 #include "includes/box.hpp"
 #include "includes/window.hpp"
@@ -6,80 +18,442 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <atomic>
+#include <cstdlib>
 #include <memory>
+#include <thread>
 #include <vector>
 
 const unsigned int WIDTH = 800;
 const unsigned int HEIGHT = 600;
 
-Window window(WIDTH, HEIGHT, "GL bouncing ball");
-Shader ballShader("shaders/ball.vert", "shaders/ball.frag");
-Shader boxShader("shaders/box.vert", "shaders/box.frag");
-Box box0(200.0f);
-Box light(25.0f);
-bool startSimulation{false};
+using Particles = ParticleState<3, float>;
 
-int main() {
+// the simulation thread steps at a fixed rate, decoupled from the frame rate
+const float simDt = 1.0f / 120.0f;
+
+std::atomic<bool> startSimulation{false};
+
+int main(int argc, char **argv) {
+  auto launched = std::chrono::steady_clock::now();
+  const uint64_t seed = seedFromArgs(argc, argv);
+  std::cout << "seed " << seed << std::endl;
+  RandomStream colors(seed, firstFreeStream);
+
+  // --replay file plays a recording instead of simulating, --record file
+  // writes one from the simulation thread
+  const char *replayPath = argValue(argc, argv, "--replay");
+  const char *recordPath = argValue(argc, argv, "--record");
+  const char *statsPath = argValue(argc, argv, "--stats");
+  // --events file logs every ball contact, --minImpulse x only the harder
+  const char *eventsPath = argValue(argc, argv, "--events");
+  const char *minImpulse = argValue(argc, argv, "--minImpulse");
+  // --view name draws what a headlessSim --publish name run is simulating
+  const char *viewName = argValue(argc, argv, "--view");
+  // --trace file writes the timing zones of both threads at exit
+  const char *tracePath = argValue(argc, argv, "--trace");
+  requireTraceZones(tracePath);
+  // --present vsync, uncapped or a frame rate to pace to
+  const PresentSettings present =
+      presentSettingsFrom(argValue(argc, argv, "--present"));
+
+  // the built in scene, --scenario file overrides what the file mentions
+  Scenario setup;
+  setup.count = 50;
+  setup.halfExtent[0] = setup.halfExtent[1] = setup.halfExtent[2] = 200.0;
+  setup.spawnExtent[0] = setup.spawnExtent[1] = setup.spawnExtent[2] = 200.0;
+  for (int d = 0; d < 3; ++d) {
+    setup.speedMin[d] = 45.0;
+    setup.speedMax[d] = 70.0;
+  }
+  setup.wallRestitution = setup.ballRestitution = 0.99;
+  if (const char *scenarioPath = argValue(argc, argv, "--scenario")) {
+    setup = loadScenario(scenarioPath, setup);
+  }
+  std::unique_ptr<ReplayPlayer<3, float>> player;
+  if (replayPath) {
+    player = std::make_unique<ReplayPlayer<3, float>>(replayPath);
+    std::cout << "replaying " << player->frameCount() << " frames, P pauses, "
+              << "LEFT/RIGHT scrub, HOME/END jump" << std::endl;
+  }
+  std::unique_ptr<TelemetryView> feed;
+  if (viewName) {
+    feed = std::make_unique<TelemetryView>(viewName);
+    if (feed->dim() != 3) {
+      throw std::runtime_error(std::string(viewName) + " is not a 3D feed");
+    }
+  }
+
+  // GL objects are locals so they are created after the context and
+  // destroyed before it; the shaders build while the meshes are set up
+  Window window(WIDTH, HEIGHT, "GL bouncing ball");
+  window.setPresentMode(present);
+  ShaderBuilder shaderBuilder(window.getWindow());
+  Shader ballShader("shaders/ball.vert", "shaders/ball.frag");
+  Shader boxShader("shaders/box.vert", "shaders/box.frag");
+  Box box0(static_cast<float>(player ? player->info().halfExtent[0]
+                                     : setup.halfExtent[0]));
+  Box light(25.0f);
+  glm::vec3 lightPos = glm::vec3(0.0f, 0.0f, 1000.0f);
+
+  box0.setRandColor(colors);
+  float halfSize = box0.halfSize;
+
+  // the box is a cube, the scene follows it on every axis
+  SceneParams<3, float> scene = sceneOf<3, float>(setup);
+  SpawnRanges<3, float> ranges = rangesOf<3, float>(setup);
+  for (int d = 0; d < 3; ++d) {
+    scene.halfExtent[d] = halfSize;
+    ranges.centerExtent[d] = std::min(ranges.centerExtent[d], halfSize);
+  }
+
+  size_t totalBalls = setup.count;
+  Particles particles;
+  spawnRandom(particles, ranges, totalBalls, seed);
+
+  // every ball is drawn with one shared sphere and keeps only a color by id,
+  // so a ball costs no GL objects; a replay's balls get colors of their own
+  std::vector<glm::vec3> ballColors(totalBalls);
+  for (glm::vec3 &c : ballColors) {
+    c = Ball::randomColor(colors);
+  }
+  Ball marker(25.0f);
+  std::vector<glm::vec3> replayColors;
+  if (player) {
+    player->seek(0);
+    RandomStream tint(seed, firstFreeStream + 1);
+    while (!player->ready()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    replayColors.resize(player->read().state.size());
+    static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "packed vec3");
+    tint.fill(reinterpret_cast<float *>(replayColors.data()),
+              replayColors.size() * 3, 0.0f, 1.0f);
+  }
+
+  // first use, waits for the ball program if it is still linking
   ballShader.use();
   ballShader.setVec3("lightColor", glm::vec3(1.0f, 1.0f, 1.0f));
-  glm::vec3 lightPos = glm::vec3(0.0f, 0.0f, 1000.0f);
   ballShader.setVec3("lightPos", lightPos);
 
-  box0.setRandColor();
-  float halfSize = box0.halfSize;
+  // physics runs on its own thread and hands immutable snapshots to the
+  // render thread, so frame N+1's physics overlaps frame N's draw
+  TripleBuffer<Snapshot<3, float>> snapshots;
+  PipelineMetrics metrics;
+  std::atomic<bool> running{true};
+
+  // R freezes the live run and scrubs back through its last few seconds,
+  // the simulation thread idles meanwhile
+  RewindBuffer<3, float> rewind;
+  std::atomic<bool> rewinding{false};
+  // set by the simulation thread once the state a rewind starts from is kept
+  std::atomic<bool> rewindMarked{false};
+  std::atomic<uint64_t> liveStep{0};
+  // the first step that resolved ball contacts, the resimulation repeats it
+  std::atomic<uint64_t> collisionsFrom{~uint64_t(0)};
+
+  auto simulate = [&] {
+    Trace::nameThread("simulation");
+    JobSystem jobs;
+    CellGrid<3, float> grid;
+    std::unique_ptr<TrajectoryRecorder<3, float>> recorder;
+    if (recordPath) {
+      recorder = std::make_unique<TrajectoryRecorder<3, float>>(recordPath,
+                                                                scene);
+    }
+    StatsStage<3, float> stage;
+    std::unique_ptr<StatsWriter> statsWriter;
+    if (statsPath) {
+      statsWriter = std::make_unique<StatsWriter>(
+          statsPath, StatsWriter::formatFor(statsPath));
+    }
+    std::unique_ptr<CollisionLog> events;
+    if (eventsPath) {
+      events = std::make_unique<CollisionLog>(
+          eventsPath, jobs.size(), minImpulse ? std::atof(minImpulse) : 0.0);
+    }
+    uint64_t step = 0;
+    auto next = std::chrono::steady_clock::now();
+    while (running) {
+      if (rewinding) {
+        if (!rewindMarked) {
+          // so the first rewind frame needs no resimulation
+          rewind.mark(particles, step);
+          rewindMarked = true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        next = std::chrono::steady_clock::now();
+        continue;
+      }
+      rewindMarked = false;
+      if (startSimulation && collisionsFrom == ~uint64_t(0)) {
+        collisionsFrom = step + 1;
+      }
+      metrics.beginStep();
+      {
+        TRACE_ZONE("physics");
+        updatePhysics(jobs, particles, scene, simDt);
+      }
+      size_t contacts = 0;
+      if (step + 1 >= collisionsFrom) {
+        TRACE_ZONE("collisions");
+        grid.build(jobs, particles, scene);
+        if (events) {
+          events->beginStep(step + 1, (step + 1) * simDt);
+          contacts =
+              grid.ballCollisions(particles, scene, events->sink(particles));
+          events->endStep();
+        } else {
+          contacts = grid.ballCollisions(particles, scene);
+        }
+      }
+      snapshots.writeBuffer().capture(particles, ++step);
+      if (statsWriter) {
+        statsWriter->push(stage.measure(jobs, particles, scene, simDt, step,
+                                        step * simDt, contacts));
+      }
+      snapshots.publish();
+      if (recorder) {
+        recorder->record(particles, step);
+      }
+      rewind.record(particles, step);
+      liveStep = step;
+      metrics.endStep();
 
-  int totalBalls = 50;
-  std::vector<std::unique_ptr<Ball>> balls;
-  balls.reserve(100);
-  for (int i = 0; i < totalBalls; ++i) {
-    auto b = std::make_unique<Ball>(25.0f);
-    b->setRandParameters(halfSize);
-    // b->color = glm::vec3(0.5f, 0.5f, 0.5f);
-    balls.push_back(std::move(b));
+      next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<float>(simDt));
+      auto now = std::chrono::steady_clock::now();
+      if (next < now - std::chrono::milliseconds(250)) {
+        next = now; // fell far behind, do not try to catch up
+      }
+      std::this_thread::sleep_until(next);
+    }
+    jobs.printStats(std::cout);
+    if (recorder) {
+      recorder->drain();
+      recorder->report(std::cout);
+    }
+    if (events) {
+      events->drain();
+      std::cout << events->events() << " contacts logged, "
+                << events->dropped() << " dropped" << std::endl;
+    }
+  };
+  std::thread simThread;
+  CellGrid<3, float> rewindGrid;
+  std::unique_ptr<RewindPlayer<3, float>> rewinder;
+  ReplayClock rewindClock;
+  rewindClock.framesPerSecond = 1.0 / simDt;
+  uint64_t rewindFirst = 0, rewindLast = 0;
+  bool rewindHeld = false, rewindPending = false;
+  if (!player && !feed) {
+    simThread = std::thread(simulate);
+    rewinder = std::make_unique<RewindPlayer<3, float>>(
+        rewind, [&](JobSystem &jobs, Particles &state, uint64_t step) {
+          updatePhysics(jobs, state, scene, simDt);
+          if (step >= collisionsFrom) {
+            rewindGrid.build(jobs, state, scene);
+            rewindGrid.ballCollisions(state, scene);
+          }
+        });
+    std::cout << "R rewinds, then P plays, LEFT/RIGHT scrub, HOME/END jump"
+              << std::endl;
   }
+  ReplayClock clock;
+  ReplayKeys replayKeys, rewindKeys;
+  TelemetryView::Frame frame;
+  uint64_t viewed = 0, torn = 0, skipped = 0, lastFrame = 0;
+  // the last frame that read back whole, copied out of shared memory
+  Particles feedBalls, feedIncoming;
+  std::vector<uint32_t> feedColor, feedColorIncoming;
+  double lastReport = glfwGetTime();
+
+  // culling stays on the render thread so it never waits on physics jobs
+  JobSystem renderJobs(1);
+  SphereCuller<float> culler;
+
+  // copied out of shared memory and kept only when the publisher did not
+  // rewrite the slot meanwhile, a torn frame is counted and the last whole
+  // one drawn again
+  auto drawFeed = [&](const float frustum[6][4], double now) {
+    if (feed->acquire(frame)) {
+      const size_t n = frame.count;
+      for (int d = 0; d < 3; ++d) {
+        feedIncoming.pos[d].assign(frame.pos[d], frame.pos[d] + n);
+      }
+      feedIncoming.radius.assign(frame.radius, frame.radius + n);
+      feedColorIncoming.assign(frame.color, frame.color + n);
+      if (!feed->valid(frame)) {
+        ++torn;
+      } else if (frame.frame != lastFrame) {
+        std::swap(feedBalls.pos, feedIncoming.pos);
+        feedBalls.radius.swap(feedIncoming.radius);
+        feedColor.swap(feedColorIncoming);
+        skipped += lastFrame && frame.frame > lastFrame + 1
+                       ? frame.frame - lastFrame - 1
+                       : 0;
+        lastFrame = frame.frame;
+        ++viewed;
+      }
+    }
+    const float *feedPos[3] = {feedBalls.pos[0].data(),
+                               feedBalls.pos[1].data(),
+                               feedBalls.pos[2].data()};
+    for (uint32_t i : culler.cull(renderJobs, feedPos, feedBalls.radius.data(),
+                                  feedBalls.radius.size(), frustum)) {
+      const uint32_t c = feedColor[i];
+      marker.color = glm::vec3(static_cast<float>(c & 0xFF),
+                               static_cast<float>(c >> 8 & 0xFF),
+                               static_cast<float>(c >> 16 & 0xFF)) /
+                     255.0f;
+      marker.setDrawRadius(feedBalls.radius[i]);
+      marker.center = glm::vec3(feedBalls.pos[0][i], feedBalls.pos[1][i],
+                                feedBalls.pos[2][i]);
+      marker.draw(ballShader);
+    }
+    if (now - lastReport >= 1.0 && lastFrame) {
+      lastReport = now;
+      std::cout << "step " << frame.step << "  balls " << frame.count
+                << "  KE " << frame.kineticEnergy << "  step " << frame.stepMs
+                << " ms" << std::endl;
+    }
+    metrics.endDraw(pipelineNowNs());
+  };
+
+  // the replay, the rewind or the live simulation
+  auto drawSnapshot = [&](const float frustum[6][4]) {
+    // a rewind shows the live frame until its first seek is done
+    const bool rewound = rewinding && !rewindPending &&
+                         rewinder->read().state.size() != 0;
+    const Snapshot<3, float> &snapshot = player    ? player->read()
+                                         : rewound ? rewinder->read()
+                                                   : snapshots.read();
+    const Particles &drawn = snapshot.state;
+    for (uint32_t i : culler.cull(renderJobs, drawn, frustum)) {
+      marker.color = player ? replayColors[drawn.id[i] % replayColors.size()]
+                            : ballColors[drawn.id[i]];
+      marker.setDrawRadius(drawn.radius[i]);
+      marker.center =
+          glm::vec3(drawn.pos[0][i], drawn.pos[1][i], drawn.pos[2][i]);
+      marker.draw(ballShader);
+    }
+    metrics.endDraw(snapshot.publishedNs);
+  };
+
+  // R enters and leaves rewind, inside it the replay keys scrub the history
+  auto controlRewind = [&](float dt) {
+    GLFWwindow *w = window.getWindow();
+    bool toggle = glfwGetKey(w, GLFW_KEY_R) == GLFW_PRESS;
+    if (toggle && !rewindHeld) {
+      rewinding = !rewinding;
+      rewindPending = rewinding;
+    }
+    rewindHeld = toggle;
+    // the live frame stays up until the simulation has kept its state
+    if (rewindPending && rewindMarked && rewind.firstStep(rewindFirst)) {
+      rewindPending = false;
+      rewindLast = liveStep;
+      rewindClock.frame = static_cast<double>(rewindLast - rewindFirst);
+      rewindClock.playing = false;
+    }
+    if (rewinding && !rewindPending) {
+      rewinder->seek(rewindFirst +
+                     rewindKeys.update(w, rewindClock, dt,
+                                       rewindLast - rewindFirst + 1));
+    }
+  };
 
   double lastTime = glfwGetTime();
+  bool firstFrame = true;
 
+  Trace::nameThread("render");
   while (!window.shouldClose()) {
     double currentTime = glfwGetTime();
     float dt = static_cast<float>(currentTime - lastTime);
     lastTime = currentTime;
 
-    window.processInput(dt);
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    {
+      TRACE_ZONE("input");
+      window.processInput(dt);
+    }
+    {
+      TRACE_ZONE("clear");
+      glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
 
-    ballShader.setViewProjection(
-        camera.GetViewMatrix(),
-        camera.GetProjectionMatrix(static_cast<float>(WIDTH) / HEIGHT));
-    boxShader.setViewProjection(
-        camera.GetViewMatrix(),
-        camera.GetProjectionMatrix(static_cast<float>(WIDTH) / HEIGHT));
+    glm::mat4 view = camera.GetViewMatrix();
+    glm::mat4 projection =
+        camera.GetProjectionMatrix(static_cast<float>(WIDTH) / HEIGHT);
+    {
+      TRACE_ZONE("view/projection");
+      ballShader.setViewProjection(view, projection);
+      boxShader.setViewProjection(view, projection);
+    }
 
-    box0.draw(boxShader);
-    light.center = glm::vec3(lightPos);
-    light.draw(boxShader);
+    {
+      TRACE_ZONE("draw");
+      metrics.beginDraw();
+      box0.draw(boxShader);
+      light.center = glm::vec3(lightPos);
+      light.draw(boxShader);
 
-    for (auto &b : balls) {
-      b->draw(ballShader);
-      b->updatePhysics(dt, halfSize, halfSize, halfSize);
+      float frustum[6][4];
+      frustumPlanes(glm::value_ptr(projection * view), frustum);
+      if (feed) {
+        drawFeed(frustum, currentTime);
+      } else {
+        drawSnapshot(frustum);
+      }
+    }
+
+    if (player) {
+      player->seek(replayKeys.update(window.getWindow(), clock, dt,
+                                     player->frameCount()));
+    }
+    if (rewinder) {
+      controlRewind(dt);
     }
 
     if (glfwGetKey(window.getWindow(), GLFW_KEY_Y)) {
       startSimulation = true;
     }
-    if (startSimulation) {
-      for (size_t i = 0; i < balls.size(); ++i) {
-        for (size_t j = i + 1; j < balls.size(); ++j) {
-          if (balls[i]->ballCollisions(*balls[j])) {
-            // balls[i]->color = glm::vec3(0.0f, 0.0f, 1.0f);
-          }
-        }
-      }
-    }
 
-    window.swapBuffersAndPollEvents();
+    {
+      TRACE_ZONE("swap");
+      window.swapBuffersAndPollEvents();
+    }
+    if (firstFrame) {
+      firstFrame = false;
+      Shader::reportStartup(std::cout);
+      std::cout << "first frame after "
+                << std::chrono::duration<double, std::milli>(
+                       std::chrono::steady_clock::now() - launched)
+                       .count()
+                << " ms" << std::endl;
+    }
+  }
+  running = false;
+  if (simThread.joinable()) {
+    simThread.join();
+  }
+  rewinder.reset();
+  if (tracePath) {
+    Trace::instance().write(tracePath);
+    std::cout << Trace::instance().zones() << " zones traced to " << tracePath
+              << std::endl;
+  }
+  metrics.report(std::cout);
+  window.frameStats().report(std::cout, window.presentMode());
+  if (rewind.snapshots()) {
+    std::cout << "rewind keeps " << rewind.snapshots() << " snapshots in "
+              << rewind.bytes() / 1024 << " KiB, "
+              << static_cast<double>(rewind.rawBytes()) / rewind.bytes()
+              << "x smaller than copies" << std::endl;
+  }
+  if (feed) {
+    std::cout << "viewed " << viewed << " frames, " << skipped
+              << " skipped, " << torn << " torn" << std::endl;
   }
-  glfwTerminate();
   return 0;
 }
@@ -1,4 +1,5 @@
 #pragma once
+#include "../../physicsCore/includes/random.hpp"
 #include "../extLibs/glad/glad.h"
 #include "shader.hpp"
 #include <glm/glm.hpp>
@@ -75,13 +76,10 @@ public:
 
     glBindVertexArray(0);
   }
-  float randFloat(float a, float b) {
-    return a + (b - a) * (static_cast<float>(rand()) / RAND_MAX);
-  }
-  void setRandColor() {
-    color.x = randFloat(0.0f, 1.0f);
-    color.y = randFloat(0.0f, 1.0f);
-    color.z = randFloat(0.0f, 1.0f);
+  void setRandColor(RandomStream &rng) {
+    color.x = rng.uniform(0.0f, 1.0f);
+    color.y = rng.uniform(0.0f, 1.0f);
+    color.z = rng.uniform(0.0f, 1.0f);
   }
 
   ~Plane() {
@@ -1,8 +1,8 @@
 #pragma once
+#include "../../physicsCore/includes/framePacing.hpp"
 #include "../extLibs/glad/glad.h"
 #include "camera.hpp"
 #include <GLFW/glfw3.h>
-#include <ctime>
 #include <stdexcept>
 
 float lastX = 400.0f; // initial window center x
@@ -44,10 +44,10 @@ public:
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
       throw std::runtime_error("Failed to initialize GLAD");
     }
+    glfwSwapInterval(1);
 
     glViewport(0, 0, width, height);
     glEnable(GL_DEPTH_TEST);
-    srand(static_cast<unsigned int>(time(0)));
   }
   void handleResize(int width, int height) { glViewport(0, 0, width, height); }
   void processInput(float dt) {
@@ -80,13 +80,35 @@ public:
 
   bool shouldClose() const { return glfwWindowShouldClose(window); }
 
+  void setPresentMode(const PresentSettings &settings) {
+    present = settings;
+    pacer = FramePacer(settings.targetFps);
+    glfwSwapInterval(settings.mode == PresentMode::vsync ? 1 : 0);
+  }
+  const PresentSettings &presentMode() const { return present; }
+  const FrameStats &frameStats() const { return stats; }
+
   void swapBuffersAndPollEvents() {
+    const uint64_t begin = pipelineNowNs();
+    if (present.mode == PresentMode::paced) {
+      pacer.wait();
+    }
+    const uint64_t presentStart = pipelineNowNs();
     glfwSwapBuffers(window);
+    const uint64_t end = pipelineNowNs();
+    if (lastPresent) {
+      stats.add(begin - lastPresent, end - presentStart, end - lastPresent);
+    }
+    lastPresent = end;
     glfwPollEvents();
   }
 
 private:
   GLFWwindow *window;
+  PresentSettings present;
+  FramePacer pacer;
+  FrameStats stats;
+  uint64_t lastPresent{0};
 
   Window(const Window &) = delete;
   Window &operator=(const Window &) = delete;
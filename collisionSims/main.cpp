@@ -1,3 +1,11 @@
+#include "../physicsCore/includes/cellGrid.hpp"
+#include "../physicsCore/includes/culling.hpp"
+#include "../physicsCore/includes/halfSpaces.hpp"
+#include "../physicsCore/includes/kernels.hpp"
+#include "../physicsCore/includes/obbColliders.hpp"
+#include "../physicsCore/includes/scenario.hpp"
+#include "../physicsCore/includes/spawn.hpp"
+#include "../physicsCore/includes/trace.hpp"
 #include "includes/ball.hpp"
 #include "includes/box.hpp"
 #include "includes/plane.hpp"
@@ -8,55 +16,197 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
 #include <memory>
 #include <vector>
 
 const unsigned int WIDTH = 800;
 const unsigned int HEIGHT = 600;
 
-Window window(WIDTH, HEIGHT, "GL bouncing ball");
-Shader boxShader("shaders/box.vert", "shaders/box.frag");
+using Particles = ParticleState<3, float>;
+
+int main(int argc, char **argv) {
+  auto launched = std::chrono::steady_clock::now();
+  const uint64_t seed = seedFromArgs(argc, argv);
+  std::cout << "seed " << seed << std::endl;
+  RandomStream colors(seed, firstFreeStream);
+  // --present vsync, uncapped or a frame rate to pace to
+  const PresentSettings present =
+      presentSettingsFrom(argValue(argc, argv, "--present"));
+
+  // GL objects are locals so they are created after the context and
+  // destroyed before it; the shaders build while the meshes are set up
+  Window window(WIDTH, HEIGHT, "GL bouncing ball");
+  window.setPresentMode(present);
+  ShaderBuilder shaderBuilder(window.getWindow());
+  Shader boxShader("shaders/box.vert", "shaders/box.frag");
+  Shader ballShader("shaders/ball.vert", "shaders/ball.frag");
 
-int main() {
   double lastTime = glfwGetTime();
+  JobSystem jobs;
+  CellGrid<3, float> grid;
+  SphereCuller<float> culler;
 
   camera.Position = glm::vec3(0.0f, 0.0f, 0.0f);
 
+  // helix of boxes, static so they are placed and registered once
   std::vector<std::unique_ptr<Box>> boxes;
   boxes.clear();
   boxes.reserve(100);
   for (int i{0}; i < 100; ++i) {
     auto b = std::make_unique<Box>();
-    b->setRandColor();
+    b->setRandColor(colors);
     boxes.push_back(std::move(b));
   }
+
+  float r = 100.0f;
+  int n = boxes.size();
+  float angleStep = glm::two_pi<float>() / n;
+
+  ObbColliders<float> colliders;
+  colliders.restitution = 0.8f;
+  for (int i = 0; i < n; ++i) {
+    float theta = i * angleStep;
+    float x = r * cos(theta);
+    float z = r * sin(theta);
+    boxes[i]->center = glm::vec3(x, i * 5 - 250.0f, z);
+    // face the helix axis and tilt down the slope
+    boxes[i]->rotationAngle = glm::vec3(0.0f, -glm::degrees(theta), 15.0f);
+
+    glm::vec3 h = boxes[i]->halfSize * boxes[i]->scaleFactor;
+    colliders.add(glm::value_ptr(boxes[i]->center),
+                  glm::value_ptr(boxes[i]->rotationAngle), glm::value_ptr(h));
+  }
+  colliders.build();
+
+  // tilted floor below the helix so balls roll off to one side
+  Plane floor(300.0f, glm::vec3(0.0f, -280.0f, 0.0f));
+  floor.rotationAngle = glm::vec3(0.0f, 0.0f, 10.0f);
+  floor.setRandColor(colors);
+
+  HalfSpaceColliders<3, float> planes;
+  planes.addPlane(glm::value_ptr(floor.center),
+                  glm::value_ptr(floor.rotationAngle), 0.6f);
+
+  // balls rain onto the helix and bounce down through it, --scenario file
+  // overrides what the file mentions
+  Scenario setup;
+  setup.count = 200;
+  for (int d = 0; d < 3; ++d) {
+    setup.halfExtent[d] = 300.0;
+    setup.spawnExtent[d] = 150.0;
+    setup.speedMax[d] = 20.0;
+  }
+  setup.gravity[1] = -98.0;
+  setup.wallRestitution = setup.ballRestitution = 0.9;
+  setup.radiusMin = 3.0;
+  setup.radiusMax = 8.0;
+  // --trace file writes the timing zones of the frame loop at exit
+  const char *tracePath = argValue(argc, argv, "--trace");
+  requireTraceZones(tracePath);
+  if (const char *scenarioPath = argValue(argc, argv, "--scenario")) {
+    setup = loadScenario(scenarioPath, setup);
+  }
+  SceneParams<3, float> scene = sceneOf<3, float>(setup);
+  SpawnRanges<3, float> ranges = rangesOf<3, float>(setup);
+
+  Particles particles;
+  spawnRandom(jobs, particles, ranges, setup.count, seed);
+  // lift the spawn box against the ceiling, never through it
+  const float lift = std::max(0.0f, scene.halfExtent[1] - ranges.radiusMax -
+                                        ranges.centerExtent[1]);
+  for (size_t i = 0; i < particles.size(); ++i) {
+    particles.pos[1][i] += lift;
+  }
+
+  // one shared sphere draws every ball, which keeps only a color by id
+  Ball sphere(8.0f);
+  std::vector<glm::vec3> ballColors(particles.size());
+  for (glm::vec3 &c : ballColors) {
+    c = Ball::randomColor(colors);
+  }
+
+  // first use, waits for the ball program if it is still linking
+  ballShader.use();
+  ballShader.setVec3("lightColor", glm::vec3(1.0f, 1.0f, 1.0f));
+  ballShader.setVec3("lightPos", glm::vec3(0.0f, 1000.0f, 0.0f));
+
+  bool firstFrame = true;
   while (!window.shouldClose()) {
     double currentTime = glfwGetTime();
     float dt = static_cast<float>(currentTime - lastTime);
     lastTime = currentTime;
 
-    window.processInput(dt);
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    {
+      TRACE_ZONE("input");
+      window.processInput(dt);
+    }
+    {
+      TRACE_ZONE("clear");
+      glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
 
-    boxShader.setViewProjection(
-        camera.GetViewMatrix(),
-        camera.GetProjectionMatrix(static_cast<float>(WIDTH) / HEIGHT));
+    glm::mat4 view = camera.GetViewMatrix();
+    glm::mat4 projection =
+        camera.GetProjectionMatrix(static_cast<float>(WIDTH) / HEIGHT);
+    {
+      TRACE_ZONE("view/projection");
+      boxShader.setViewProjection(view, projection);
+      ballShader.setViewProjection(view, projection);
+    }
 
-    float r = 100.0f;
-    int n = boxes.size();
-    float angleStep = glm::two_pi<float>() / n;
+    {
+      TRACE_ZONE("draw");
+      boxShader.use();
+      for (auto &b : boxes) {
+        b->draw(boxShader);
+      }
+      floor.draw(boxShader);
 
-    for (int i = 0; i < n; ++i) {
-      float theta = i * angleStep;
-      float x = r * cos(theta);
-      float z = r * sin(theta);
-      boxes[i]->center = glm::vec3(x, i * 5, z);
-      boxes[i]->draw(boxShader);
+      float frustum[6][4];
+      frustumPlanes(glm::value_ptr(projection * view), frustum);
+      for (uint32_t i : culler.cull(jobs, particles, frustum)) {
+        sphere.color = ballColors[particles.id[i]];
+        sphere.setDrawRadius(particles.radius[i]);
+        sphere.center = glm::vec3(particles.pos[0][i], particles.pos[1][i],
+                                  particles.pos[2][i]);
+        sphere.draw(ballShader);
+      }
     }
 
-    window.swapBuffersAndPollEvents();
+    {
+      TRACE_ZONE("physics");
+      updatePhysics(jobs, particles, scene, dt);
+    }
+    {
+      TRACE_ZONE("collisions");
+      grid.build(jobs, particles, scene);
+      grid.ballCollisions(particles, scene);
+      colliders.collide(jobs, particles);
+      planes.collide(jobs, particles);
+    }
+
+    {
+      TRACE_ZONE("swap");
+      window.swapBuffersAndPollEvents();
+    }
+    if (firstFrame) {
+      firstFrame = false;
+      Shader::reportStartup(std::cout);
+      std::cout << "first frame after "
+                << std::chrono::duration<double, std::milli>(
+                       std::chrono::steady_clock::now() - launched)
+                       .count()
+                << " ms" << std::endl;
+    }
+  }
+  jobs.printStats(std::cout);
+  window.frameStats().report(std::cout, window.presentMode());
+  if (tracePath) {
+    Trace::instance().write(tracePath);
+    std::cout << Trace::instance().zones() << " zones traced to " << tracePath
+              << std::endl;
   }
-  glfwTerminate();
   return 0;
 }
@@ -0,0 +1,1334 @@
+// Headless physics benchmark, no window or GL context needed.
+// build: g++ -O2 -std=c++17 -pthread main.cpp -o headlessSim
+// (add -lrt for shm_open on glibc older than 2.34)
+#include "../physicsCore/includes/benchCompare.hpp"
+#include "../physicsCore/includes/cellGrid.hpp"
+#include "../physicsCore/includes/checkpoint.hpp"
+#include "../physicsCore/includes/collisionLog.hpp"
+#include "../physicsCore/includes/deterministic.hpp"
+#include "../physicsCore/includes/kernels.hpp"
+#include "../physicsCore/includes/particlePool.hpp"
+#include "../physicsCore/includes/perfCounters.hpp"
+#include "../physicsCore/includes/rewind.hpp"
+#include "../physicsCore/includes/scenario.hpp"
+#include "../physicsCore/includes/slabDecomposition.hpp"
+#include "../physicsCore/includes/spawn.hpp"
+#include "../physicsCore/includes/stats.hpp"
+#include "../physicsCore/includes/telemetry.hpp"
+#include "../physicsCore/includes/trajectory.hpp"
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// every run spawns the same balls unless --seed says otherwise
+uint64_t benchSeed = 42;
+
+template <int Dim, typename Real> SceneParams<Dim, Real> benchScene() {
+  SceneParams<Dim, Real> scene;
+  for (int d = 0; d < Dim; ++d) {
+    scene.halfExtent[d] = 200;
+  }
+  scene.gravity[1] = static_cast<Real>(-9.8);
+  // perfectly elastic walls so any energy change comes from the integrator
+  scene.wallRestitution = 1;
+  return scene;
+}
+
+template <int Dim, typename Real>
+ParticleState<Dim, Real> benchState(int count) {
+  SpawnRanges<Dim, Real> ranges;
+  for (int d = 0; d < Dim; ++d) {
+    ranges.centerExtent[d] = 175;
+    ranges.speedMin[d] = 0;
+    ranges.speedMax[d] = 70;
+  }
+  ranges.radiusMin = 5;
+  ranges.radiusMax = 25;
+  ParticleState<Dim, Real> s;
+  spawnRandom(s, ranges, count, benchSeed);
+  return s;
+}
+
+// kinetic plus gravitational potential energy, summed in double
+template <int Dim, typename Real>
+double totalEnergy(const ParticleState<Dim, Real> &s,
+                   const SceneParams<Dim, Real> &scene) {
+  double e = 0.0;
+  for (size_t i = 0; i < s.size(); ++i) {
+    double v2 = 0.0, h = 0.0;
+    for (int d = 0; d < Dim; ++d) {
+      v2 += static_cast<double>(s.vel[d][i]) * s.vel[d][i];
+      h += static_cast<double>(scene.gravity[d]) * s.pos[d][i];
+    }
+    e += s.mass[i] * (0.5 * v2 - h);
+  }
+  return e;
+}
+
+template <typename Integrator, int Dim, typename Real>
+void runIntegrator(const char *label, int count, int steps, Real dt) {
+  SceneParams<Dim, Real> scene = benchScene<Dim, Real>();
+  ParticleState<Dim, Real> s = benchState<Dim, Real>(count);
+  double e0 = totalEnergy(s, scene);
+
+  auto start = std::chrono::steady_clock::now();
+  for (int step = 0; step < steps; ++step) {
+    updatePhysics<Integrator>(s, scene, dt);
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  double ns = std::chrono::duration<double, std::nano>(end - start).count();
+  double drift = (totalEnergy(s, scene) - e0) / e0;
+  printf("%-18s %-10s %8.5f %12.2f %14.3e\n", Integrator::name, label,
+         static_cast<double>(dt), ns / (static_cast<double>(count) * steps),
+         drift);
+}
+
+// same step through the JobSystem at several worker counts
+void runParallel(int count, int steps, unsigned threads) {
+  SceneParams<3, float> scene = benchScene<3, float>();
+  ParticleState<3, float> s = benchState<3, float>(count);
+  JobSystem jobs(threads);
+
+  auto start = std::chrono::steady_clock::now();
+  for (int step = 0; step < steps; ++step) {
+    updatePhysics(jobs, s, scene, 1.0f / 60.0f);
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  double ns = std::chrono::duration<double, std::nano>(end - start).count();
+  printf("threads=%u %12.2f ns/ball-step\n", threads,
+         ns / (static_cast<double>(count) * steps));
+  jobs.printStats(std::cout);
+}
+
+// counting sort grid build alone, the balls move between builds as in a frame
+void runGridBuild(int count, int steps, unsigned threads) {
+  SceneParams<3, float> scene = benchScene<3, float>();
+  ParticleState<3, float> s = benchState<3, float>(count);
+  JobSystem jobs(threads);
+  CellGrid<3, float> grid;
+  grid.build(jobs, s, scene); // warm up the buffers
+
+  double ns = 0.0;
+  for (int step = 0; step < steps; ++step) {
+    updatePhysics(jobs, s, scene, 1.0f / 60.0f);
+    auto start = std::chrono::steady_clock::now();
+    grid.build(jobs, s, scene);
+    auto end = std::chrono::steady_clock::now();
+    ns += std::chrono::duration<double, std::nano>(end - start).count();
+  }
+  printf("threads=%u %12.2f ns/ball-build (%zu cells)\n", threads,
+         ns / (static_cast<double>(count) * steps), grid.cellCount());
+}
+
+// smaller balls than benchState so the contact passes stay affordable
+ParticleState<3, float> contactState(int count) {
+  SpawnRanges<3, float> ranges;
+  for (int d = 0; d < 3; ++d) {
+    ranges.centerExtent[d] = 195;
+    ranges.speedMin[d] = 0;
+    ranges.speedMax[d] = 70;
+  }
+  ranges.radiusMin = 2;
+  ranges.radiusMax = 4;
+  ParticleState<3, float> s;
+  spawnRandom(s, ranges, count, benchSeed);
+  return s;
+}
+
+// fast path: grid plus serial Gauss-Seidel contacts
+double runContactsFast(int count, int steps, unsigned threads) {
+  SceneParams<3, float> scene = benchScene<3, float>();
+  ParticleState<3, float> s = contactState(count);
+  JobSystem jobs(threads);
+  CellGrid<3, float> grid;
+
+  auto start = std::chrono::steady_clock::now();
+  for (int step = 0; step < steps; ++step) {
+    updatePhysics(jobs, s, scene, 1.0f / 60.0f);
+    grid.build(jobs, s, scene);
+    grid.ballCollisions(s, scene);
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() /
+         (static_cast<double>(count) * steps);
+}
+
+// deterministic path, returns the state hash after every step
+std::vector<uint64_t> runContactsDeterministic(int count, int steps,
+                                               unsigned threads, double &ns) {
+  SceneParams<3, float> scene = benchScene<3, float>();
+  ParticleState<3, float> s = contactState(count);
+  JobSystem jobs(threads);
+  DeterministicSim<3, float> sim;
+  std::vector<uint64_t> hashes;
+  hashes.reserve(steps);
+
+  double hashNs = 0.0;
+  auto start = std::chrono::steady_clock::now();
+  for (int step = 0; step < steps; ++step) {
+    sim.step(jobs, s, scene, 1.0f / 60.0f);
+    auto hashStart = std::chrono::steady_clock::now();
+    hashes.push_back(sim.hash(jobs, s));
+    hashNs += std::chrono::duration<double, std::nano>(
+                  std::chrono::steady_clock::now() - hashStart)
+                  .count();
+  }
+  auto end = std::chrono::steady_clock::now();
+  ns = (std::chrono::duration<double, std::nano>(end - start).count() -
+        hashNs) /
+       (static_cast<double>(count) * steps);
+  return hashes;
+}
+
+void runDeterminism(int count, int steps, unsigned hw) {
+  std::vector<unsigned> threadCounts = {1, 2, 4};
+  if (hw > 4) {
+    threadCounts.push_back(hw);
+  }
+  std::vector<uint64_t> reference;
+  for (unsigned threads : threadCounts) {
+    double fast = runContactsFast(count, steps, threads);
+    double exact = 0.0;
+    std::vector<uint64_t> hashes =
+        runContactsDeterministic(count, steps, threads, exact);
+    if (reference.empty()) {
+      reference = hashes;
+    }
+    int diverged = -1;
+    for (size_t k = 0; k < hashes.size() && diverged < 0; ++k) {
+      if (hashes[k] != reference[k]) {
+        diverged = static_cast<int>(k);
+      }
+    }
+    printf("threads=%u fast %10.2f deterministic %10.2f ns/ball-step "
+           "(x%.2f) hash %016llx %s",
+           threads, fast, exact, exact / fast,
+           static_cast<unsigned long long>(hashes.back()),
+           diverged < 0 ? "identical" : "DIVERGED");
+    if (diverged >= 0) {
+      printf(" at step %d", diverged);
+    }
+    printf("\n");
+  }
+}
+
+// one worker process per slab, reports communication against compute
+int runSlabMode(int ranks, int count, int steps) {
+  SceneParams<3, float> scene = benchScene<3, float>();
+  SpawnRanges<3, float> ranges;
+  for (int d = 0; d < 3; ++d) {
+    ranges.centerExtent[d] = 195;
+    ranges.speedMin[d] = 0;
+    ranges.speedMax[d] = 70;
+  }
+  ranges.radiusMin = 2;
+  ranges.radiusMax = 4;
+  unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+  unsigned threads = std::max(1u, hw / ranks);
+
+  printf("balls=%d steps=%d slabs=%d threads/slab=%u\n", count, steps, ranks,
+         threads);
+  std::vector<SlabReport> reports = runSlabs<3, float>(
+      ranks, scene, ranges, count, steps, 1.0f / 60.0f, threads, benchSeed);
+
+  printf("%-5s %10s %10s %10s %12s %12s %8s\n", "slab", "owned", "halo/step",
+         "migrated", "compute ms", "comm ms", "comm %");
+  uint64_t total = 0;
+  for (int r = 0; r < ranks; ++r) {
+    const SlabReport &report = reports[r];
+    if (report.rank < 0) {
+      printf("%-5d failed\n", r);
+      continue;
+    }
+    total += report.owned;
+    double step = report.computeMs + report.commMs;
+    printf("%-5d %10llu %10.1f %10llu %12.3f %12.3f %7.1f%%\n", r,
+           static_cast<unsigned long long>(report.owned), report.halo,
+           static_cast<unsigned long long>(report.migrated),
+           report.computeMs, report.commMs,
+           step > 0.0 ? 100.0 * report.commMs / step : 0.0);
+  }
+  printf("balls after run %llu of %d\n",
+         static_cast<unsigned long long>(total), count);
+  return total == static_cast<uint64_t>(count) ? 0 : 1;
+}
+
+// serial against parallel spawn, every run must produce the same balls
+void runSpawn(int count, unsigned hw) {
+  SpawnRanges<3, float> ranges;
+  for (int d = 0; d < 3; ++d) {
+    ranges.centerExtent[d] = 195;
+    ranges.speedMax[d] = 70;
+  }
+  ranges.radiusMin = 2;
+  ranges.radiusMax = 4;
+  JobSystem hashJobs(1);
+  DeterministicSim<3, float> hasher;
+
+  auto start = std::chrono::steady_clock::now();
+  ParticleState<3, float> serial;
+  spawnRandom(serial, ranges, count, benchSeed);
+  double ns = std::chrono::duration<double, std::nano>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+  const uint64_t reference = hasher.hash(hashJobs, serial);
+  printf("serial     %10.2f ns/ball hash %016llx\n", ns / count,
+         static_cast<unsigned long long>(reference));
+
+  for (unsigned threads = 1; threads <= hw; threads *= 2) {
+    JobSystem jobs(threads);
+    ParticleState<3, float> s;
+    start = std::chrono::steady_clock::now();
+    spawnRandom(jobs, s, ranges, count, benchSeed);
+    ns = std::chrono::duration<double, std::nano>(
+             std::chrono::steady_clock::now() - start)
+             .count();
+    const uint64_t h = hasher.hash(hashJobs, s);
+    printf("threads=%-3u%10.2f ns/ball hash %016llx %s\n", threads, ns / count,
+           static_cast<unsigned long long>(h),
+           h == reference ? "identical" : "DIFFERENT");
+  }
+
+  // bulk colour draws: fill must give what uniform() one at a time gives,
+  // including the tail past the last whole block and the draw after it
+  const size_t n = static_cast<size_t>(count) * 3 + 1;
+  std::vector<float> bulk(n + 1), single(n + 1);
+  RandomStream bulkRng(benchSeed, firstFreeStream);
+  RandomStream singleRng(benchSeed, firstFreeStream);
+  start = std::chrono::steady_clock::now();
+  bulkRng.fill(bulk.data(), n, 0.0f, 1.0f);
+  const double fillNs = std::chrono::duration<double, std::nano>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+  start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < n; ++i) {
+    single[i] = singleRng.uniform(0.0f, 1.0f);
+  }
+  const double singleNs = std::chrono::duration<double, std::nano>(
+                              std::chrono::steady_clock::now() - start)
+                              .count();
+  bulk[n] = bulkRng.uniform(0.0f, 1.0f);
+  single[n] = singleRng.uniform(0.0f, 1.0f);
+  printf("fill       %10.2f ns/value, uniform %.2f ns/value %s\n",
+         fillNs / n, singleNs / n, bulk == single ? "identical" : "DIFFERENT");
+}
+
+// one kernel of runCounters: its counters and wall time over every step
+struct CountedKernel {
+  explicit CountedKernel(const char *name) : name(name) {}
+
+  const char *name;
+  PerfCounters counters;
+  double ns{0.0};
+
+  template <typename Fn> void run(const Fn &fn) {
+    counters.resume();
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    ns += std::chrono::duration<double, std::nano>(
+              std::chrono::steady_clock::now() - start)
+              .count();
+    counters.pause();
+  }
+};
+
+// why a kernel is as fast as it is: hardware counters per ball and step,
+// bytes/ball is what the LLC misses pulled from memory at 64 per line
+void runCounters(int count, int steps, unsigned threads) {
+  SceneParams<3, float> scene = benchScene<3, float>();
+  ParticleState<3, float> s = contactState(count);
+  // the counters follow the threads started after them
+  CountedKernel kernels[4] = {
+      CountedKernel("integrate"), CountedKernel("collisionCheck"),
+      CountedKernel("broadphase"), CountedKernel("ballCollisions")};
+  JobSystem jobs(threads);
+  CellGrid<3, float> grid;
+  grid.build(jobs, s, scene); // warm up the buffers
+
+  for (int step = 0; step < steps; ++step) {
+    // the two halves of updatePhysics, which fuses them per chunk
+    kernels[0].run([&] {
+      jobs.parallelFor(0, s.size(), kernelGrain,
+                       [&](size_t b, size_t e, size_t) {
+                         integrate<SemiImplicitEuler>(s, scene, 1.0f / 60.0f,
+                                                      b, e);
+                       });
+    });
+    kernels[1].run([&] {
+      jobs.parallelFor(0, s.size(), kernelGrain,
+                       [&](size_t b, size_t e, size_t) {
+                         collisionCheck(s, scene, b, e);
+                       });
+    });
+    kernels[2].run([&] { grid.build(jobs, s, scene); });
+    kernels[3].run([&] { grid.ballCollisions(s, scene); });
+  }
+
+  if (!kernels[0].counters.any()) {
+    printf("no hardware counters (%s), times only\n",
+           kernels[0].counters.why().c_str());
+  } else if (!kernels[0].counters.why().empty()) {
+    printf("some hardware counters missing (%s)\n",
+           kernels[0].counters.why().c_str());
+  }
+  printf("%-16s %10s %6s %10s %10s %10s %10s\n", "kernel", "ns/ball", "IPC",
+         "L1D/ball", "LLC/ball", "br/ball", "bytes/ball");
+  const double ballSteps = static_cast<double>(count) * steps;
+  for (CountedKernel &k : kernels) {
+    PerfCounters::Totals t = k.counters.read();
+    auto column = [](bool valid, double value, int width, int precision) {
+      if (valid) {
+        printf(" %*.*f", width, precision, value);
+      } else {
+        printf(" %*s", width, "-");
+      }
+    };
+    printf("%-16s %10.2f", k.name, k.ns / ballSteps);
+    column(t.valid[PerfCounters::cycles] &&
+               t.valid[PerfCounters::instructions] &&
+               t.value[PerfCounters::cycles] > 0,
+           t.value[PerfCounters::instructions] /
+               std::max(t.value[PerfCounters::cycles], 1.0),
+           6, 2);
+    column(t.valid[PerfCounters::l1Misses],
+           t.value[PerfCounters::l1Misses] / ballSteps, 10, 3);
+    column(t.valid[PerfCounters::llcMisses],
+           t.value[PerfCounters::llcMisses] / ballSteps, 10, 3);
+    column(t.valid[PerfCounters::branchMisses],
+           t.value[PerfCounters::branchMisses] / ballSteps, 10, 3);
+    column(t.valid[PerfCounters::llcMisses],
+           t.value[PerfCounters::llcMisses] * 64.0 / ballSteps, 10, 1);
+    printf("\n");
+  }
+}
+
+// let balls settle under gravity, checkpointing along the way
+int runSettle(const char *path, int count, int steps) {
+  SceneParams<3, float> scene = benchScene<3, float>();
+  scene.wallRestitution = 0.5f;
+  scene.ballRestitution = 0.5f;
+  ParticleState<3, float> s = contactState(count);
+  JobSystem jobs;
+  CellGrid<3, float> grid;
+  CheckpointWriter<3, float> writer;
+
+  double maxStallMs = 0.0, maxStepMs = 0.0, maxAfterMs = 0.0;
+  int written = 0;
+  bool after = false;
+  const int every = std::max(1, steps / 4);
+  for (int step = 1; step <= steps; ++step) {
+    auto stepStart = std::chrono::steady_clock::now();
+    updatePhysics(jobs, s, scene, 1.0f / 60.0f);
+    grid.build(jobs, s, scene);
+    grid.ballCollisions(s, scene);
+    // the first writes after a fork copy the pages they touch
+    const double stepMs = std::chrono::duration<double, std::milli>(
+                              std::chrono::steady_clock::now() - stepStart)
+                              .count();
+    double &slot = after ? maxAfterMs : maxStepMs;
+    slot = std::max(slot, stepMs);
+    after = false;
+    if (step % every == 0 || step == steps) {
+      if (step == steps) {
+        writer.wait(); // the final state must not be skipped
+      }
+      auto start = std::chrono::steady_clock::now();
+      CheckpointInfo info{static_cast<uint64_t>(step), benchSeed,
+                          static_cast<uint64_t>(count)};
+      after = writer.submit(path, s, scene, info);
+      written += after;
+      maxStallMs = std::max(maxStallMs,
+                            std::chrono::duration<double, std::milli>(
+                                std::chrono::steady_clock::now() - start)
+                                .count());
+    }
+  }
+  writer.wait();
+  if (writer.lastFailed()) {
+    printf("writing %s failed\n", path);
+    return 1;
+  }
+  printf("settled %d balls for %d steps, %d checkpoints, %.2f MB each\n",
+         count, steps, written, writer.lastBytes() / 1048576.0);
+  printf("sim thread stall per checkpoint max %.3f ms, background write "
+         "%.3f ms\n",
+         maxStallMs, writer.lastWriteMs());
+  printf("step max %.3f ms, right after a checkpoint max %.3f ms\n",
+         maxStepMs, maxAfterMs);
+  return 0;
+}
+
+// map a checkpoint and carry on from it
+int runResume(const char *path, int steps) {
+  auto start = std::chrono::steady_clock::now();
+  Checkpoint<3, float> checkpoint(path);
+  auto mapped = std::chrono::steady_clock::now();
+  ParticleState<3, float> s;
+  checkpoint.restore(s);
+  auto restored = std::chrono::steady_clock::now();
+  SceneParams<3, float> scene = checkpoint.scene();
+  CheckpointInfo info = checkpoint.info();
+
+  printf("resumed %zu balls at step %llu (seed %llu)\n", s.size(),
+         static_cast<unsigned long long>(info.step),
+         static_cast<unsigned long long>(info.seed));
+  printf("map %.3f ms, copy into state %.3f ms\n",
+         std::chrono::duration<double, std::milli>(mapped - start).count(),
+         std::chrono::duration<double, std::milli>(restored - mapped).count());
+
+  JobSystem jobs;
+  CellGrid<3, float> grid;
+  for (int step = 0; step < steps; ++step) {
+    updatePhysics(jobs, s, scene, 1.0f / 60.0f);
+    grid.build(jobs, s, scene);
+    grid.ballCollisions(s, scene);
+  }
+  printf("ran %d more steps\n", steps);
+  return 0;
+}
+
+// record every step, then read the last frame back to check the error
+int runRecord(const char *path, int count, int steps) {
+  SceneParams<3, float> scene = benchScene<3, float>();
+  scene.wallRestitution = 0.5f;
+  scene.ballRestitution = 0.5f;
+  ParticleState<3, float> s = contactState(count);
+  JobSystem jobs;
+  CellGrid<3, float> grid;
+
+  double maxStallMs = 0.0, totalStallMs = 0.0;
+  {
+    TrajectoryRecorder<3, float> recorder(path, scene);
+    for (int step = 1; step <= steps; ++step) {
+      updatePhysics(jobs, s, scene, 1.0f / 60.0f);
+      grid.build(jobs, s, scene);
+      grid.ballCollisions(s, scene);
+      auto start = std::chrono::steady_clock::now();
+      recorder.record(s, static_cast<uint64_t>(step));
+      double ms = std::chrono::duration<double, std::milli>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+      maxStallMs = std::max(maxStallMs, ms);
+      totalStallMs += ms;
+    }
+    recorder.drain();
+    recorder.report(std::cout);
+  }
+  printf("sim thread stall per frame mean %.3f ms, max %.3f ms\n",
+         totalStallMs / std::max(1, steps), maxStallMs);
+
+  TrajectoryReader<3, float> reader(path);
+  reader.seek(jobs, reader.frameCount() - 1);
+  double maxError = 0.0;
+  for (size_t i = 0; i < s.size(); ++i) {
+    for (int d = 0; d < 3; ++d) {
+      maxError = std::max(maxError, std::fabs(static_cast<double>(
+                                        reader.pos(d, s.id[i]) - s.pos[d][i])));
+    }
+  }
+  printf("last frame (step %llu) max position error %.4f\n",
+         static_cast<unsigned long long>(reader.step(reader.frameCount() - 1)),
+         maxError);
+  return 0;
+}
+
+// seek costs of a recorded trajectory, what scrubbing in the apps pays
+int runReplay(const char *path) {
+  JobSystem jobs;
+  TrajectoryReader<3, float> reader(path);
+  ParticleState<3, float> s;
+  const size_t frames = reader.frameCount();
+  reader.seek(jobs, 0);
+  printf("%zu frames of %zu balls, keyframe every %u\n", frames,
+         reader.ballCount(), reader.info().keyframeInterval);
+
+  auto timed = [&](const char *label, size_t seeks, auto frameOf) {
+    double total = 0.0, worst = 0.0;
+    for (size_t i = 0; i < seeks; ++i) {
+      auto start = std::chrono::steady_clock::now();
+      reader.seek(jobs, frameOf(i));
+      reader.fill(jobs, s);
+      double ms = std::chrono::duration<double, std::milli>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+      total += ms;
+      worst = std::max(worst, ms);
+    }
+    printf("%-10s avg %8.3f ms, max %8.3f ms per frame\n", label,
+           total / seeks, worst);
+  };
+  timed("forward", frames, [](size_t i) { return i; });
+  timed("backward", frames, [&](size_t i) { return frames - 1 - i; });
+  RandomStream rng(benchSeed, firstFreeStream);
+  timed("random", std::min<size_t>(frames, 100),
+        [&](size_t) { return rng.next() % frames; });
+  return 0;
+}
+
+// rewind history of a live run: what capture costs the step, how well it
+// compresses, and that scrubbing back lands on the very same states
+int runRewind(int count, int steps) {
+  SceneParams<3, float> scene = benchScene<3, float>();
+  scene.ballRestitution = 0.9f;
+  ParticleState<3, float> s = contactState(count);
+  JobSystem jobs;
+  CellGrid<3, float> grid;
+  DeterministicSim<3, float> hasher;
+  RewindBuffer<3, float> rewind(size_t(256) << 20, 120);
+  const float dt = 1.0f / 60.0f;
+  auto physics = [&scene, dt](JobSystem &j, CellGrid<3, float> &g,
+                              ParticleState<3, float> &state) {
+    updatePhysics(j, state, scene, dt);
+    g.build(j, state, scene);
+    g.ballCollisions(state, scene);
+  };
+
+  std::vector<uint64_t> hashes(steps + 1);
+  rewind.record(s, 0);
+  hashes[0] = hasher.hash(jobs, s);
+  double stepMs = 0.0, recordMs = 0.0, worstRecord = 0.0;
+  for (int step = 1; step <= steps; ++step) {
+    auto start = std::chrono::steady_clock::now();
+    physics(jobs, grid, s);
+    auto stepped = std::chrono::steady_clock::now();
+    rewind.record(s, step);
+    double ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - stepped)
+                    .count();
+    stepMs +=
+        std::chrono::duration<double, std::milli>(stepped - start).count();
+    recordMs += ms;
+    worstRecord = std::max(worstRecord, ms);
+    hashes[step] = hasher.hash(jobs, s);
+  }
+  uint64_t first = 0;
+  rewind.firstStep(first);
+  printf("%zu snapshots from step %llu, %.1f MB for %.1f MB raw (%.2fx)\n",
+         rewind.snapshots(), static_cast<unsigned long long>(first),
+         rewind.bytes() / 1e6, rewind.rawBytes() / 1e6,
+         static_cast<double>(rewind.rawBytes()) /
+             std::max<size_t>(rewind.bytes(), 1));
+  printf("step %.3f ms, record avg %.3f ms max %.3f ms\n", stepMs / steps,
+         recordMs / steps, worstRecord);
+
+  // scrub back over the whole history a step per 60 Hz frame, timed from
+  // seek to shown as the render thread sees it, from the live state as a
+  // rewind started from the window would
+  rewind.mark(s, steps);
+  CellGrid<3, float> replayGrid;
+  RewindPlayer<3, float> player(
+      rewind, [&](JobSystem &j, ParticleState<3, float> &state, uint64_t) {
+        physics(j, replayGrid, state);
+      });
+  const auto frame = std::chrono::microseconds(16667);
+  auto deadline = std::chrono::steady_clock::now();
+  // the first seek restores the mark
+  double total = 0.0, worst = 0.0, firstMs = 0.0;
+  int seeks = 0;
+  for (int step = steps; step >= static_cast<int>(first); --step, ++seeks) {
+    auto start = std::chrono::steady_clock::now();
+    player.seek(step);
+    while (player.shownStep() != static_cast<uint64_t>(step)) {
+      std::this_thread::yield();
+    }
+    double ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+    if (seeks == 0) {
+      firstMs = ms;
+    } else {
+      total += ms;
+      worst = std::max(worst, ms);
+    }
+    deadline = std::max(deadline + frame, std::chrono::steady_clock::now());
+    std::this_thread::sleep_until(deadline);
+  }
+  printf("backward scrub at 60 Hz, first seek %.3f ms, then seek to shown "
+         "avg %.3f ms, max %.3f ms\n",
+         firstMs, total / std::max(seeks - 1, 1), worst);
+
+  // restore and resimulate a few steps, compared bit for bit
+  int matched = 0, checked = 0;
+  ParticleState<3, float> again;
+  CellGrid<3, float> checkGrid;
+  for (int step = steps; step >= static_cast<int>(first); step -= 37) {
+    uint64_t at = 0;
+    rewind.restore(step, again, at);
+    for (; at < static_cast<uint64_t>(step); ++at) {
+      physics(jobs, checkGrid, again);
+    }
+    matched += hasher.hash(jobs, again) == hashes[step];
+    ++checked;
+  }
+  printf("%d of %d restored states identical\n", matched, checked);
+  return matched == checked ? 0 : 1;
+}
+
+// statistics every step, timed against the step they describe
+int runStats(const char *path, int count, int steps) {
+  SceneParams<3, float> scene = benchScene<3, float>();
+  scene.wallRestitution = 0.9f;
+  scene.ballRestitution = 0.9f;
+  ParticleState<3, float> s = contactState(count);
+  JobSystem jobs;
+  CellGrid<3, float> grid;
+  StatsStage<3, float> stage;
+  const float dt = 1.0f / 60.0f;
+
+  double stepMs = 0.0, statsMs = 0.0;
+  StepStats first, last;
+  {
+    StatsWriter writer(path, StatsWriter::formatFor(path));
+    for (int step = 1; step <= steps; ++step) {
+      auto start = std::chrono::steady_clock::now();
+      updatePhysics(jobs, s, scene, dt);
+      grid.build(jobs, s, scene);
+      size_t contacts = grid.ballCollisions(s, scene);
+      auto stepped = std::chrono::steady_clock::now();
+      last = stage.measure(jobs, s, scene, dt, step, step * dt, contacts);
+      writer.push(last);
+      auto measured = std::chrono::steady_clock::now();
+      stepMs += std::chrono::duration<double, std::milli>(stepped - start)
+                    .count();
+      statsMs += std::chrono::duration<double, std::milli>(measured - stepped)
+                     .count();
+      if (step == 1) {
+        first = last;
+      }
+    }
+    writer.drain();
+    printf("%llu rows written, %llu dropped\n",
+           static_cast<unsigned long long>(writer.rows()),
+           static_cast<unsigned long long>(writer.dropped()));
+  }
+  printf("kinetic energy %.4g -> %.4g, wall pressure %.4g, contacts %llu\n",
+         first.kineticEnergy, last.kineticEnergy, last.wallPressure,
+         static_cast<unsigned long long>(last.contacts));
+  printf("step %.3f ms, stats %.3f ms (%.2f%% of the step)\n",
+         stepMs / steps, statsMs / steps, 100.0 * statsMs / stepMs);
+  return 0;
+}
+
+// parallel contact solver with and without the event log on the same balls
+int runEvents(const char *path, int count, int steps, double minImpulse) {
+  SceneParams<3, float> scene = benchScene<3, float>();
+  JobSystem jobs;
+  const float dt = 1.0f / 60.0f;
+  auto run = [&](CollisionLog *log) {
+    ParticleState<3, float> s = contactState(count);
+    DeterministicSim<3, float> sim;
+    auto start = std::chrono::steady_clock::now();
+    for (int step = 1; step <= steps; ++step) {
+      if (log) {
+        log->beginStep(step, step * dt);
+        sim.step(jobs, s, scene, dt, log->sink(s));
+        log->endStep();
+      } else {
+        sim.step(jobs, s, scene, dt);
+      }
+    }
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+  };
+
+  // alternated and the best of three kept, the runs are short and noisy
+  double plain = 1e300, logged = 1e300;
+  uint64_t events = 0, dropped = 0;
+  for (int rep = 0; rep < 3; ++rep) {
+    plain = std::min(plain, run(nullptr));
+    CollisionLog log(path, jobs.size(), minImpulse);
+    logged = std::min(logged, run(&log));
+    log.drain();
+    events = log.events();
+    dropped = log.dropped();
+  }
+  printf("plain %.3f ms/step, logged %.3f ms/step, overhead %.1f%%\n",
+         plain / steps, logged / steps, 100.0 * (logged - plain) / plain);
+  printf("%llu events written (impulse >= %g), %llu dropped, "
+         "%.2f M events/s\n",
+         static_cast<unsigned long long>(events), minImpulse,
+         static_cast<unsigned long long>(dropped), events / (logged * 1e3));
+  return 0;
+}
+
+volatile std::sig_atomic_t interrupted = 0;
+
+// Balls streaming through a pool: an emitter at the top, a sink along the
+// floor and merges of freshly emitted pairs. Reports what spawn, destroy
+// and handle checks cost, that stale handles are caught and that the
+// columns were never reallocated after the first steps.
+int runChurn(int count, int steps) {
+  SceneParams<3, float> scene = benchScene<3, float>();
+  scene.gravity[1] = -400.0f;
+  scene.wallRestitution = scene.ballRestitution = 0.5f;
+  const size_t capacity = static_cast<size_t>(count) * 2;
+  ParticlePool<3, float> pool(capacity);
+  ParticleState<3, float> initial = contactState(count);
+  for (size_t i = 0; i < initial.size(); ++i) {
+    pool.spawnCopy(initial, i);
+  }
+  JobSystem jobs;
+  CellGrid<3, float> grid;
+  RandomStream rng(benchSeed, firstFreeStream);
+  const int perStep = std::max(1, count / 100);
+  std::vector<ParticleHandle> emitted, gone;
+  emitted.reserve(perStep);
+  gone.reserve(capacity);
+
+  double spawnNs = 0.0, destroyNs = 0.0;
+  uint64_t spawned = 0, destroyed = 0, merged = 0, refused = 0;
+  size_t warmCapacity = 0;
+  bool reallocated = false;
+  auto columnsCapacity = [&] {
+    const ParticleState<3, float> &s = pool.state();
+    size_t c = std::min(s.radius.capacity(), s.mass.capacity());
+    for (int d = 0; d < 3; ++d) {
+      c = std::min({c, s.pos[d].capacity(), s.vel[d].capacity()});
+    }
+    return std::min(c, s.id.capacity());
+  };
+  for (int step = 0; step < steps; ++step) {
+    ParticleState<3, float> &s = pool.state();
+    updatePhysics(jobs, s, scene, 1.0f / 60.0f);
+    grid.build(jobs, s, scene);
+    grid.ballCollisions(s, scene);
+
+    // sink: everything resting on the floor, from the back as it moves
+    auto start = std::chrono::steady_clock::now();
+    const float floor = 4.0f - scene.halfExtent[1];
+    for (size_t i = s.size(); i-- > 0;) {
+      if (s.pos[1][i] - s.radius[i] < floor) {
+        gone.push_back(pool.handleAt(i));
+        pool.destroyAt(i);
+        ++destroyed;
+      }
+    }
+    destroyNs += std::chrono::duration<double, std::nano>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+
+    // emitter: a spray from the top of the box
+    emitted.clear();
+    start = std::chrono::steady_clock::now();
+    for (int k = 0; k < perStep; ++k) {
+      float p[3] = {rng.uniform(-150.0f, 150.0f), 190.0f,
+                    rng.uniform(-150.0f, 150.0f)};
+      float v[3] = {rng.uniform(-30.0f, 30.0f), rng.uniform(-60.0f, 0.0f),
+                    rng.uniform(-30.0f, 30.0f)};
+      ParticleHandle h = pool.spawn(p, v, rng.uniform(2.0f, 4.0f), 10.0f);
+      if (pool.alive(h)) {
+        emitted.push_back(h);
+        ++spawned;
+      } else {
+        ++refused;
+      }
+    }
+    spawnNs += std::chrono::duration<double, std::nano>(
+                   std::chrono::steady_clock::now() - start)
+                   .count();
+
+    // merges: every fourth pair of the spray becomes one ball of the same
+    // mass, momentum and volume
+    for (size_t k = 1; k < emitted.size(); k += 8) {
+      const size_t a = pool.indexOf(emitted[k - 1]);
+      const size_t b = pool.indexOf(emitted[k]);
+      const float ma = s.mass[a], mb = s.mass[b];
+      for (int d = 0; d < 3; ++d) {
+        s.vel[d][a] = (ma * s.vel[d][a] + mb * s.vel[d][b]) / (ma + mb);
+      }
+      s.mass[a] = ma + mb;
+      s.radius[a] = std::cbrt(s.radius[a] * s.radius[a] * s.radius[a] +
+                              s.radius[b] * s.radius[b] * s.radius[b]);
+      gone.push_back(emitted[k]);
+      pool.destroy(emitted[k]);
+      ++merged;
+    }
+
+    if (step == 10) {
+      warmCapacity = columnsCapacity();
+    } else if (step > 10 && columnsCapacity() != warmCapacity) {
+      reallocated = true;
+    }
+  }
+
+  // every handle that was destroyed must read as stale, even with its slot
+  // taken again by a newer ball
+  size_t caught = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (const ParticleHandle &h : gone) {
+    caught += !pool.alive(h);
+  }
+  const double checkNs = std::chrono::duration<double, std::nano>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+  size_t found = 0;
+  for (size_t i = 0; i < pool.size(); ++i) {
+    found += pool.indexOf(pool.handleAt(i)) == i;
+  }
+
+  printf("%d steps, %zu balls left of %zu slots, %llu spawned (%llu refused),"
+         " %llu sunk, %llu merged\n",
+         steps, pool.size(), pool.capacity(),
+         static_cast<unsigned long long>(spawned),
+         static_cast<unsigned long long>(refused),
+         static_cast<unsigned long long>(destroyed),
+         static_cast<unsigned long long>(merged));
+  printf("spawn %.1f ns, sink sweep %.1f ns per ball removed, handle check "
+         "%.1f ns\n",
+         spawnNs / std::max<uint64_t>(spawned + refused, 1),
+         destroyNs / std::max<uint64_t>(destroyed, 1),
+         checkNs / std::max<size_t>(gone.size(), 1));
+  printf("%zu of %zu stale handles caught, %zu of %zu live balls found, "
+         "columns %s\n",
+         caught, gone.size(), found, pool.size(),
+         reallocated ? "REALLOCATED" : "never reallocated");
+  return caught == gone.size() && found == pool.size() && !reallocated ? 0
+                                                                       : 1;
+}
+
+// publish every step to shared memory for a viewer in another process,
+// steps 0 runs until interrupted
+int runPublish(const char *name, int count, int steps) {
+  SceneParams<3, float> scene = benchScene<3, float>();
+  scene.wallRestitution = 0.9f;
+  scene.ballRestitution = 0.9f;
+  ParticleState<3, float> s = contactState(count);
+  JobSystem jobs;
+  CellGrid<3, float> grid;
+  StatsStage<3, float> stage;
+  const float dt = 1.0f / 60.0f;
+
+  std::vector<uint32_t> colors(s.size());
+  std::vector<float> rgb(colors.size() * 3);
+  RandomStream tint(benchSeed, firstFreeStream);
+  tint.fill(rgb.data(), rgb.size(), 0.0f, 1.0f);
+  for (size_t i = 0; i < colors.size(); ++i) {
+    colors[i] = packColor(rgb[3 * i], rgb[3 * i + 1], rgb[3 * i + 2]);
+  }
+
+  TelemetryPublisher<3, float> publisher(name, s.size());
+  std::signal(SIGINT, [](int) { interrupted = 1; });
+  printf("publishing %zu balls as %s, ctrl-c stops\n", s.size(), name);
+
+  double stepMs = 0.0, publishMs = 0.0;
+  int step = 0;
+  while (!interrupted && (steps == 0 || step < steps)) {
+    ++step;
+    auto start = std::chrono::steady_clock::now();
+    updatePhysics(jobs, s, scene, dt);
+    grid.build(jobs, s, scene);
+    size_t contacts = grid.ballCollisions(s, scene);
+    auto stepped = std::chrono::steady_clock::now();
+    double ms =
+        std::chrono::duration<double, std::milli>(stepped - start).count();
+
+    StepStats st = stage.measure(jobs, s, scene, dt, step, step * dt, contacts);
+    TelemetryFrameStats frame{st.step, st.time, ms, st.kineticEnergy,
+                              st.contacts};
+    publisher.publish(jobs, s, colors.data(), frame);
+    stepMs += ms;
+    publishMs += std::chrono::duration<double, std::milli>(
+                     std::chrono::steady_clock::now() - stepped)
+                     .count();
+  }
+  printf("%d steps, step %.3f ms, stats and publish %.3f ms\n", step,
+         stepMs / std::max(1, step), publishMs / std::max(1, step));
+  return 0;
+}
+
+struct ScenarioRun {
+  unsigned threads;
+  double ms; // all steps
+  size_t contacts;
+  double drift;
+};
+
+template <int Dim, typename Real>
+ScenarioRun simulateScenario(const Scenario &sc) {
+  SceneParams<Dim, Real> scene = sceneOf<Dim, Real>(sc);
+  JobSystem jobs(sc.threads);
+  ParticleState<Dim, Real> s;
+  spawnRandom(jobs, s, rangesOf<Dim, Real>(sc), sc.count, sc.seed);
+  CellGrid<Dim, Real> grid;
+  const Real dt = static_cast<Real>(sc.dt);
+  double e0 = totalEnergy(s, scene);
+
+  size_t contacts = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int step = 0; step < sc.steps; ++step) {
+    updatePhysics(jobs, s, scene, dt);
+    grid.build(jobs, s, scene);
+    contacts += grid.ballCollisions(s, scene);
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  double ms = std::chrono::duration<double, std::milli>(end - start).count();
+  double drift = e0 != 0.0 ? (totalEnergy(s, scene) - e0) / e0 : 0.0;
+  return ScenarioRun{jobs.size(), ms, contacts, drift};
+}
+
+// ns per ball and step, what the regression gate compares
+double scenarioNs(const Scenario &sc) {
+  ScenarioRun run;
+  if (sc.dim == 2) {
+    run = sc.doublePrecision ? simulateScenario<2, double>(sc)
+                             : simulateScenario<2, float>(sc);
+  } else {
+    run = sc.doublePrecision ? simulateScenario<3, double>(sc)
+                             : simulateScenario<3, float>(sc);
+  }
+  return run.ms * 1e6 /
+         (static_cast<double>(sc.count) * std::max(1, sc.steps));
+}
+
+// one scenario of a sweep, a row of the table printed by runScenarios
+template <int Dim, typename Real> void runScenario(const Scenario &sc) {
+  const ScenarioRun run = simulateScenario<Dim, Real>(sc);
+  const int steps = std::max(1, sc.steps);
+  printf("%-12s %-28s %dd %-6s %9zu %7u %10.3f %12.2f %12.1f %12.3e\n",
+         sc.name.c_str(), sc.label.c_str(), Dim,
+         sizeof(Real) == 8 ? "double" : "float", sc.count, run.threads,
+         run.ms / steps,
+         run.ms * 1e6 / (static_cast<double>(sc.count) * steps),
+         static_cast<double>(run.contacts) / steps, run.drift);
+}
+
+// every combination of a scenario file, scaling curves without rebuilding
+int runScenarios(const char *path) {
+  Scenario defaults;
+  defaults.seed = benchSeed;
+  std::vector<Scenario> all;
+  try {
+    all = loadScenarios(path, defaults);
+  } catch (const std::runtime_error &e) {
+    printf("%s\n", e.what());
+    return 1;
+  }
+  printf("%zu scenarios from %s\n", all.size(), path);
+  printf("%-12s %-28s %-2s %-6s %9s %7s %10s %12s %12s %12s\n", "name",
+         "sweep", "", "real", "balls", "threads", "ms/step", "ns/ball-step",
+         "contacts", "energy drift");
+  for (const Scenario &sc : all) {
+    if (sc.dim == 2) {
+      sc.doublePrecision ? runScenario<2, double>(sc)
+                         : runScenario<2, float>(sc);
+    } else {
+      sc.doublePrecision ? runScenario<3, double>(sc)
+                         : runScenario<3, float>(sc);
+    }
+  }
+  return 0;
+}
+
+// Fixed scenarios the regression gate times. Change one and old baselines
+// no longer compare, so bump regressionSuiteName with it.
+const char *regressionSuiteName = "collisions-1";
+
+std::vector<Scenario> regressionSuite() {
+  Scenario base;
+  base.threads = 1; // worker scheduling adds more noise than it shows
+  base.seed = 42;
+  base.radiusMin = 2;
+  base.radiusMax = 4;
+  for (int d = 0; d < 3; ++d) {
+    base.gravity[d] = 0;
+  }
+
+  Scenario dense = base;
+  dense.name = "dense gas";
+  dense.count = 20000;
+  dense.halfExtent[0] = dense.halfExtent[1] = dense.halfExtent[2] = 100;
+  dense.steps = 40;
+
+  Scenario sparse = base;
+  sparse.name = "sparse gas";
+  sparse.count = 20000;
+  sparse.halfExtent[0] = sparse.halfExtent[1] = sparse.halfExtent[2] = 400;
+  sparse.steps = 40;
+
+  // falls into a heap within the first second and keeps settling
+  Scenario pile = base;
+  pile.name = "settling pile";
+  pile.count = 10000;
+  pile.halfExtent[0] = pile.halfExtent[1] = pile.halfExtent[2] = 100;
+  pile.gravity[1] = -500;
+  pile.wallRestitution = pile.ballRestitution = 0.5;
+  pile.steps = 90;
+
+  Scenario discs = base;
+  discs.name = "2d discs";
+  discs.dim = 2;
+  discs.count = 20000;
+  discs.halfExtent[0] = discs.halfExtent[1] = 300;
+  discs.steps = 60;
+
+  return {dense, sparse, pile, discs};
+}
+
+// times the suite reps times over, each scenario once per round so slow
+// spells of the machine spread over all of them
+std::vector<BenchSamples> runRegressionSuite(int reps) {
+  std::vector<Scenario> suite = regressionSuite();
+  std::vector<BenchSamples> out(suite.size());
+  for (size_t k = 0; k < suite.size(); ++k) {
+    out[k].name = suite[k].name;
+    scenarioNs(suite[k]); // warm up caches and the allocator
+  }
+  for (int rep = 0; rep < reps; ++rep) {
+    for (size_t k = 0; k < suite.size(); ++k) {
+      out[k].values.push_back(scenarioNs(suite[k]));
+    }
+  }
+  return out;
+}
+
+int runBaseline(const char *path, int reps) {
+  std::vector<BenchSamples> results = runRegressionSuite(reps);
+  for (const BenchSamples &b : results) {
+    printf("%-14s %10.2f ns/ball-step, %5.1f%% spread\n", b.name.c_str(),
+           b.median(), 100.0 * b.variation());
+  }
+  writeBaseline(path, regressionSuiteName, results);
+  printf("baseline written to %s\n", path);
+  return 0;
+}
+
+// Fails when a scenario got slower by more than tolerance and the samples
+// say it is not chance. Faster runs pass and are reported.
+int runCompare(const char *path, int reps, double tolerance) {
+  std::string suite;
+  std::vector<BenchSamples> baseline;
+  try {
+    baseline = loadBaseline(path, suite);
+  } catch (const std::runtime_error &e) {
+    printf("%s\n", e.what());
+    return 2;
+  }
+  if (suite != regressionSuiteName) {
+    printf("%s holds suite '%s', this build runs '%s'; write a new "
+           "baseline\n",
+           path, suite.c_str(), regressionSuiteName);
+    return 2;
+  }
+  const double alpha = 0.01;
+  for (const BenchSamples &b : baseline) {
+    const double best = smallestSlowerPValue(b.values.size(), reps);
+    if (best >= alpha) {
+      printf("%s: %zu baseline samples against %d runs cannot reach p < "
+             "%.2f (at best %.4f); use more --reps for both\n",
+             b.name.c_str(), b.values.size(), reps, alpha, best);
+      return 2;
+    }
+  }
+  std::vector<BenchSamples> current = runRegressionSuite(reps);
+  printf("%-14s %12s %12s %8s %8s %15s  %s\n", "scenario", "baseline",
+         "current", "change", "p", "spread", "verdict");
+  int regressions = 0;
+  for (const BenchSamples &now : current) {
+    auto was = std::find_if(
+        baseline.begin(), baseline.end(),
+        [&](const BenchSamples &b) { return b.name == now.name; });
+    if (was == baseline.end()) {
+      printf("%-14s %12s %12.2f %8s %8s %15s  not in baseline\n",
+             now.name.c_str(), "-", now.median(), "-", "-", "-");
+      continue;
+    }
+    const double change = now.median() / was->median() - 1.0;
+    const double p = slowerPValue(was->values, now.values);
+    const double pFaster = slowerPValue(now.values, was->values);
+    const char *verdict = "ok";
+    if (change > tolerance && p < alpha) {
+      verdict = "REGRESSION";
+      ++regressions;
+    } else if (change < -tolerance && pFaster < alpha) {
+      verdict = "faster";
+    } else if (now.variation() > 2.0 * std::max(was->variation(), 0.01)) {
+      verdict = "ok, noisier than baseline";
+    }
+    printf("%-14s %12.2f %12.2f %+7.1f%% %8.4f %6.1f%% -> %5.1f%%  %s\n",
+           now.name.c_str(), was->median(), now.median(), 100.0 * change, p,
+           100.0 * was->variation(), 100.0 * now.variation(), verdict);
+  }
+  printf("ns/ball-step medians of %d runs against %zu, a regression is over "
+         "%.0f%% slower at p < %.2f\n",
+         reps, baseline.front().values.size(), 100.0 * tolerance, alpha);
+  if (regressions) {
+    printf("%d of %zu scenarios regressed\n", regressions, current.size());
+    return 1;
+  }
+  printf("no regressions\n");
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  // headlessSim [--seed N] [--slabs N] [--settle file] [--resume file]
+  //             [--record file] [--replay file] [--scenario file]
+  //             [--stats file] [--publish name]
+  //             [--events file [--minImpulse x]] [--rewind] [--counters]
+  //             [--baseline file | --compare file] [--reps N]
+  //             [--tolerance x] [--churn]
+  //             [count] [steps]
+  std::vector<const char *> positional;
+  int ranks = 0;
+  const char *settlePath = nullptr;
+  const char *resumePath = nullptr;
+  const char *recordPath = nullptr;
+  const char *replayPath = nullptr;
+  const char *scenarioPath = nullptr;
+  const char *statsPath = nullptr;
+  const char *publishName = nullptr;
+  const char *eventsPath = nullptr;
+  double minImpulse = 0.0;
+  bool rewind = false;
+  bool counters = false;
+  bool churn = false;
+  const char *baselinePath = nullptr;
+  const char *comparePath = nullptr;
+  int reps = 7;
+  double tolerance = 0.05;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      benchSeed = strtoull(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--slabs") == 0 && i + 1 < argc) {
+      ranks = std::max(1, atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--settle") == 0 && i + 1 < argc) {
+      settlePath = argv[++i];
+    } else if (strcmp(argv[i], "--resume") == 0 && i + 1 < argc) {
+      resumePath = argv[++i];
+    } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+      recordPath = argv[++i];
+    } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+      replayPath = argv[++i];
+    } else if (strcmp(argv[i], "--scenario") == 0 && i + 1 < argc) {
+      scenarioPath = argv[++i];
+    } else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+      statsPath = argv[++i];
+    } else if (strcmp(argv[i], "--publish") == 0 && i + 1 < argc) {
+      publishName = argv[++i];
+    } else if (strcmp(argv[i], "--events") == 0 && i + 1 < argc) {
+      eventsPath = argv[++i];
+    } else if (strcmp(argv[i], "--minImpulse") == 0 && i + 1 < argc) {
+      minImpulse = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--rewind") == 0) {
+      rewind = true;
+    } else if (strcmp(argv[i], "--counters") == 0) {
+      counters = true;
+    } else if (strcmp(argv[i], "--churn") == 0) {
+      churn = true;
+    } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+      baselinePath = argv[++i];
+    } else if (strcmp(argv[i], "--compare") == 0 && i + 1 < argc) {
+      comparePath = argv[++i];
+    } else if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) {
+      reps = std::max(5, atoi(argv[++i])); // fewer cannot reach p < 0.01
+    } else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+      tolerance = atof(argv[++i]);
+    } else {
+      positional.push_back(argv[i]);
+    }
+  }
+  if (scenarioPath) {
+    return runScenarios(scenarioPath);
+  }
+  if (baselinePath) {
+    return runBaseline(baselinePath, reps);
+  }
+  if (comparePath) {
+    return runCompare(comparePath, reps, tolerance);
+  }
+  if (replayPath) {
+    return runReplay(replayPath);
+  }
+  if (resumePath) {
+    int steps = positional.size() > 0 ? atoi(positional[0]) : 100;
+    return runResume(resumePath, steps);
+  }
+  int count = positional.size() > 0 ? atoi(positional[0]) : 100000;
+  if (settlePath) {
+    int steps = positional.size() > 1 ? atoi(positional[1]) : 600;
+    return runSettle(settlePath, count, steps);
+  }
+  if (publishName) {
+    int steps = positional.size() > 1 ? atoi(positional[1]) : 0;
+    return runPublish(publishName, count, steps);
+  }
+  unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+  if (counters) {
+    int steps = positional.size() > 1 ? atoi(positional[1]) : 100;
+    runCounters(count, steps, hw);
+    return 0;
+  }
+  if (churn) {
+    int steps = positional.size() > 1 ? atoi(positional[1]) : 600;
+    return runChurn(count, steps);
+  }
+  if (rewind) {
+    int steps = positional.size() > 1 ? atoi(positional[1]) : 600;
+    return runRewind(count, steps);
+  }
+  if (eventsPath) {
+    int steps = positional.size() > 1 ? atoi(positional[1]) : 100;
+    return runEvents(eventsPath, count, steps, minImpulse);
+  }
+  if (statsPath) {
+    int steps = positional.size() > 1 ? atoi(positional[1]) : 200;
+    return runStats(statsPath, count, steps);
+  }
+  if (recordPath) {
+    int steps = positional.size() > 1 ? atoi(positional[1]) : 600;
+    return runRecord(recordPath, count, steps);
+  }
+  if (ranks > 0) {
+    int steps = positional.size() > 1 ? atoi(positional[1]) : 100;
+    return runSlabMode(ranks, count, steps);
+  }
+  int steps = positional.size() > 1 ? atoi(positional[1]) : 1000;
+
+  printf("balls=%d steps=%d\n", count, steps);
+  printf("%-18s %-10s %8s %12s %14s\n", "integrator", "state", "dt",
+         "ns/ball-step", "energy drift");
+  for (float dt : {1.0f / 120.0f, 1.0f / 60.0f, 1.0f / 30.0f}) {
+    runIntegrator<ExplicitEuler, 3, float>("3d float", count, steps, dt);
+    runIntegrator<SemiImplicitEuler, 3, float>("3d float", count, steps, dt);
+    runIntegrator<VelocityVerlet, 3, float>("3d float", count, steps, dt);
+    runIntegrator<RK4, 3, float>("3d float", count, steps, dt);
+  }
+
+  // same kernels at other dimensions and precisions
+  const double dt = 1.0 / 60.0;
+  runIntegrator<SemiImplicitEuler, 2, float>("2d float", count, steps,
+                                             static_cast<float>(dt));
+  runIntegrator<SemiImplicitEuler, 3, double>("3d double", count, steps, dt);
+  runIntegrator<VelocityVerlet, 3, double>("3d double", count, steps, dt);
+
+  printf("\nparallel updatePhysics\n");
+  for (unsigned threads = 1; threads < hw; threads *= 2) {
+    runParallel(count, steps, threads);
+  }
+  runParallel(count, steps, hw);
+
+  printf("\ncell grid build\n");
+  for (unsigned threads = 1; threads < hw; threads *= 2) {
+    runGridBuild(count, steps / 10 + 1, threads);
+  }
+  runGridBuild(count, steps / 10 + 1, hw);
+
+  printf("\ndeterministic contacts vs fast path\n");
+  runDeterminism(count, steps / 10 + 1, hw);
+
+  printf("\nspawn\n");
+  runSpawn(count, hw);
+
+  printf("\nhardware counters, threads=%u\n", hw);
+  runCounters(count, steps / 10 + 1, hw);
+  return 0;
+}
@@ -0,0 +1,170 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Repeated timings of one benchmark and what a regression gate compares:
+// the median, which a stray slow run does not move, and the spread.
+struct BenchSamples {
+  std::string name;
+  std::vector<double> values; // one per repetition, lower is better
+
+  double median() const {
+    if (values.empty()) {
+      return 0.0;
+    }
+    std::vector<double> v = values;
+    std::sort(v.begin(), v.end());
+    const size_t n = v.size();
+    return n % 2 ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+  }
+
+  double variance() const {
+    if (values.size() < 2) {
+      return 0.0;
+    }
+    double mean = 0.0;
+    for (double x : values) {
+      mean += x;
+    }
+    mean /= values.size();
+    double sum = 0.0;
+    for (double x : values) {
+      sum += (x - mean) * (x - mean);
+    }
+    return sum / (values.size() - 1);
+  }
+
+  // relative spread, comparable across benchmarks of any size
+  double variation() const {
+    const double m = median();
+    return m > 0.0 ? std::sqrt(variance()) / m : 0.0;
+  }
+};
+
+// One sided Mann-Whitney U test: the chance that samples at least this much
+// slower than the baseline turn up when both come from the same machine and
+// code. Uses ranks only, so it holds for the skewed distributions timings
+// have; normal approximation with ties counted half.
+inline double slowerPValue(const std::vector<double> &baseline,
+                           const std::vector<double> &current) {
+  const double n1 = static_cast<double>(current.size());
+  const double n2 = static_cast<double>(baseline.size());
+  if (n1 == 0 || n2 == 0) {
+    return 1.0;
+  }
+  double u = 0.0;
+  for (double c : current) {
+    for (double b : baseline) {
+      u += c > b ? 1.0 : (c == b ? 0.5 : 0.0);
+    }
+  }
+  const double mean = 0.5 * n1 * n2;
+  const double sigma = std::sqrt(n1 * n2 * (n1 + n2 + 1) / 12.0);
+  const double z = (u - mean - 0.5) / sigma; // continuity correction
+  return 0.5 * std::erfc(z / std::sqrt(2.0));
+}
+
+// The smallest p slowerPValue can return for these sample counts, reached
+// when every current sample is slower than every baseline one. A gate at
+// alpha needs this below alpha or it can never fire.
+inline double smallestSlowerPValue(size_t baseline, size_t current) {
+  return slowerPValue(std::vector<double>(baseline, 0.0),
+                      std::vector<double>(current, 1.0));
+}
+
+// Baseline file, written by writeBaseline and read back by loadBaseline,
+// which understands this layout rather than JSON in general:
+//
+//   {"suite": "...", "benchmarks": [
+//     {"name": "...", "median": m, "variance": v, "samples": [x, ...]},
+//   ]}
+inline void writeBaseline(const std::string &path, const std::string &suite,
+                          const std::vector<BenchSamples> &all) {
+  std::FILE *file = std::fopen(path.c_str(), "w");
+  if (!file) {
+    throw std::runtime_error("cannot create baseline " + path);
+  }
+  std::fprintf(file, "{\"suite\": \"%s\", \"benchmarks\": [\n",
+               suite.c_str());
+  for (size_t k = 0; k < all.size(); ++k) {
+    const BenchSamples &b = all[k];
+    std::fprintf(file,
+                 "  {\"name\": \"%s\", \"median\": %.6g, \"variance\": %.6g, "
+                 "\"samples\": [",
+                 b.name.c_str(), b.median(), b.variance());
+    for (size_t i = 0; i < b.values.size(); ++i) {
+      std::fprintf(file, "%s%.6g", i ? ", " : "", b.values[i]);
+    }
+    std::fprintf(file, "]}%s\n", k + 1 < all.size() ? "," : "");
+  }
+  std::fprintf(file, "]}\n");
+  std::fclose(file);
+}
+
+inline std::vector<BenchSamples> loadBaseline(const std::string &path,
+                                              std::string &suite) {
+  std::ifstream in(path);
+  if (!in) {
+    throw std::runtime_error("cannot open baseline " + path);
+  }
+  std::stringstream buffer;
+  buffer << in.rdbuf();
+  const std::string text = buffer.str();
+
+  // the string value after "key": from pos on, npos when there is none
+  auto stringAfter = [&](const std::string &key, size_t &pos) {
+    pos = text.find("\"" + key + "\"", pos);
+    if (pos == std::string::npos) {
+      return std::string();
+    }
+    const size_t open = text.find('"', text.find(':', pos) + 1);
+    const size_t close = text.find('"', open + 1);
+    if (open == std::string::npos || close == std::string::npos) {
+      throw std::runtime_error(path + ": unterminated string");
+    }
+    pos = close + 1;
+    return text.substr(open + 1, close - open - 1);
+  };
+
+  size_t pos = 0;
+  suite = stringAfter("suite", pos);
+  pos = pos == std::string::npos ? 0 : pos;
+  std::vector<BenchSamples> all;
+  for (;;) {
+    BenchSamples b;
+    b.name = stringAfter("name", pos);
+    if (pos == std::string::npos) {
+      break;
+    }
+    pos = text.find("\"samples\"", pos);
+    const size_t open = text.find('[', pos);
+    const size_t close = text.find(']', open);
+    if (pos == std::string::npos || open == std::string::npos ||
+        close == std::string::npos) {
+      throw std::runtime_error(path + ": " + b.name + " has no samples");
+    }
+    std::istringstream values(text.substr(open + 1, close - open - 1));
+    std::string value;
+    while (std::getline(values, value, ',')) {
+      char *end = nullptr;
+      b.values.push_back(std::strtod(value.c_str(), &end));
+      if (end == value.c_str()) {
+        throw std::runtime_error(path + ": " + b.name + ": bad sample '" +
+                                 value + "'");
+      }
+    }
+    pos = close + 1;
+    all.push_back(b);
+  }
+  if (all.empty()) {
+    throw std::runtime_error(path + ": no benchmarks");
+  }
+  return all;
+}
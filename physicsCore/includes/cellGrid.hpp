@@ -0,0 +1,293 @@
+#pragma once
+#include "jobSystem.hpp"
+#include "kernels.hpp"
+#include "particles.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// Broadphase grid rebuilt every step with a parallel counting sort.
+// build() computes each ball's cell in parallel, sorts the cell keys with LSD
+// radix passes (per chunk histogram, exclusive prefix sum, stable scatter),
+// then reorders every ParticleState column so the balls of one cell sit next
+// to each other. Cells are at least one diameter wide, so contacts are only
+// ever with the same or an adjacent cell. All buffers are members and only
+// grow, so after the first few frames a build allocates nothing.
+template <int Dim, typename Real> class CellGrid {
+public:
+  CellGrid() {
+    // half of the neighbourhood, each adjacent cell pair is visited once
+    int o[3] = {-1, -1, -1};
+    for (o[2] = Dim == 3 ? -1 : 0; o[2] <= (Dim == 3 ? 1 : 0); ++o[2])
+      for (o[1] = -1; o[1] <= 1; ++o[1])
+        for (o[0] = -1; o[0] <= 1; ++o[0]) {
+          bool forward = o[2] > 0 || (o[2] == 0 && o[1] > 0) ||
+                         (o[2] == 0 && o[1] == 0 && o[0] > 0);
+          if (forward) {
+            neighbours.push_back({o[0], o[1], o[2]});
+          }
+        }
+  }
+
+  // sorts s by cell, the balls of cell c are [cellStart[c], cellStart[c + 1])
+  void build(JobSystem &jobs, ParticleState<Dim, Real> &s,
+             const SceneParams<Dim, Real> &scene) {
+    Real lo[Dim], hi[Dim];
+    for (int d = 0; d < Dim; ++d) {
+      lo[d] = -scene.halfExtent[d];
+      hi[d] = scene.halfExtent[d];
+    }
+    build(jobs, s, lo, hi);
+  }
+
+  // same over the box [lo, hi], balls outside it land in the border cells
+  void build(JobSystem &jobs, ParticleState<Dim, Real> &s, const Real *lo,
+             const Real *hi) {
+    const size_t n = s.size();
+    setupCells(jobs, s, lo, hi);
+    grow(keys, n);
+    grow(values, n);
+    grow(keysAlt, n);
+    grow(valuesAlt, n);
+
+    jobs.parallelFor(0, n, grain, [&](size_t b, size_t e, size_t) {
+      for (size_t i = b; i < e; ++i) {
+        keys[i] = cellOf(s, i);
+        values[i] = static_cast<uint32_t>(i);
+      }
+    });
+
+    int bits = 1;
+    while (bits < 32 && (size_t(1) << bits) < numCells) {
+      ++bits;
+    }
+    for (int shift = 0; shift < bits; shift += digitBits) {
+      radixPass(jobs, n, shift);
+    }
+
+    // cells (keys[i - 1], keys[i]] all start at i, empty cells included
+    grow(cellStart, numCells + 1);
+    jobs.parallelFor(0, n, grain, [&](size_t b, size_t e, size_t) {
+      for (size_t i = b; i < e; ++i) {
+        uint32_t first = i == 0 ? 0 : keys[i - 1] + 1;
+        for (uint32_t c = first; c <= keys[i]; ++c) {
+          cellStart[c] = static_cast<uint32_t>(i);
+        }
+      }
+    });
+    uint32_t tail = n == 0 ? 0 : keys[n - 1] + 1;
+    for (size_t c = tail; c <= numCells; ++c) {
+      cellStart[c] = static_cast<uint32_t>(n);
+    }
+
+    reorder(jobs, s);
+  }
+
+  // Gauss-Seidel pass over the sorted balls, returns the contacts resolved
+  template <typename ContactLog = NoContactLog>
+  size_t ballCollisions(ParticleState<Dim, Real> &s,
+                        const SceneParams<Dim, Real> &scene,
+                        const ContactLog &log = {}) const {
+    size_t contacts = 0;
+    const Real e = scene.ballRestitution;
+    forEachCellPair([&](uint32_t a0, uint32_t a1, uint32_t b0, uint32_t b1,
+                        bool same) {
+      for (uint32_t i = a0; i < a1; ++i) {
+        for (uint32_t j = same ? i + 1 : b0; j < b1; ++j) {
+          contacts += resolveContact(s, i, j, e, log);
+        }
+      }
+    });
+    return contacts;
+  }
+
+  size_t cellCount() const { return numCells; }
+  const std::vector<uint32_t> &starts() const { return cellStart; }
+
+  // calls fn(begin, end, otherBegin, otherEnd, sameCell) for every cell and
+  // each of its forward neighbours that holds balls
+  template <typename Fn> void forEachCellPair(Fn fn) const {
+    for (int z = 0; z < dims[2]; ++z)
+      for (int y = 0; y < dims[1]; ++y)
+        for (int x = 0; x < dims[0]; ++x) {
+          const size_t c = index(x, y, z);
+          const uint32_t a0 = cellStart[c], a1 = cellStart[c + 1];
+          if (a0 == a1) {
+            continue;
+          }
+          fn(a0, a1, a0, a1, true);
+          for (const auto &o : neighbours) {
+            int nx = x + o[0], ny = y + o[1], nz = z + o[2];
+            if (nx < 0 || ny < 0 || nz < 0 || nx >= dims[0] ||
+                ny >= dims[1] || nz >= dims[2]) {
+              continue;
+            }
+            const size_t nc = index(nx, ny, nz);
+            if (cellStart[nc] != cellStart[nc + 1]) {
+              fn(a0, a1, cellStart[nc], cellStart[nc + 1], false);
+            }
+          }
+        }
+  }
+
+  // calls fn(j) for every other ball in the cells around ball i, always in
+  // the same order for a given sorted state
+  template <typename Fn>
+  void forEachNearby(const ParticleState<Dim, Real> &s, size_t i,
+                     Fn fn) const {
+    int c[3];
+    coordsOf(s, i, c);
+    const int zr = Dim == 3 ? 1 : 0;
+    for (int z = std::max(c[2] - zr, 0); z <= std::min(c[2] + zr, dims[2] - 1);
+         ++z)
+      for (int y = std::max(c[1] - 1, 0); y <= std::min(c[1] + 1, dims[1] - 1);
+           ++y)
+        for (int x = std::max(c[0] - 1, 0);
+             x <= std::min(c[0] + 1, dims[0] - 1); ++x) {
+          const size_t nc = index(x, y, z);
+          for (uint32_t j = cellStart[nc]; j < cellStart[nc + 1]; ++j) {
+            if (j != i) {
+              fn(j);
+            }
+          }
+        }
+  }
+
+private:
+  static constexpr size_t grain = 16384;
+  static constexpr int digitBits = 11;
+  static constexpr uint32_t radix = 1u << digitBits;
+  static constexpr int maxCellsPerAxis = Dim == 3 ? 256 : 4096;
+
+  int dims[3]{1, 1, 1};
+  Real invCell[Dim]{};
+  Real origin[Dim]{};
+  size_t numCells{1};
+  std::vector<std::array<int, 3>> neighbours;
+
+  std::vector<uint32_t> keys, values, keysAlt, valuesAlt;
+  std::vector<uint32_t> histogram;
+  std::vector<uint32_t> cellStart;
+  std::vector<Real> chunkMax;
+  std::vector<Real> scratch;
+  std::vector<uint32_t> scratchId;
+
+  template <typename T> static void grow(std::vector<T> &v, size_t n) {
+    if (v.size() < n) {
+      v.resize(n);
+    }
+  }
+
+  size_t index(int x, int y, int z) const {
+    return (static_cast<size_t>(z) * dims[1] + y) * dims[0] + x;
+  }
+
+  void coordsOf(const ParticleState<Dim, Real> &s, size_t i, int c[3]) const {
+    c[0] = c[1] = c[2] = 0;
+    for (int d = 0; d < Dim; ++d) {
+      int v = static_cast<int>((s.pos[d][i] - origin[d]) * invCell[d]);
+      c[d] = std::min(std::max(v, 0), dims[d] - 1);
+    }
+  }
+
+  uint32_t cellOf(const ParticleState<Dim, Real> &s, size_t i) const {
+    int c[3];
+    coordsOf(s, i, c);
+    return static_cast<uint32_t>(index(c[0], c[1], c[2]));
+  }
+
+  // cells span the box and are at least the largest diameter wide
+  void setupCells(JobSystem &jobs, const ParticleState<Dim, Real> &s,
+                  const Real *lo, const Real *hi) {
+    const size_t chunks = JobSystem::chunkCount(s.size(), grain);
+    grow(chunkMax, chunks);
+    jobs.parallelFor(0, s.size(), grain, [&](size_t b, size_t e, size_t c) {
+      Real m = 0;
+      for (size_t i = b; i < e; ++i) {
+        m = std::max(m, s.radius[i]);
+      }
+      chunkMax[c] = m;
+    });
+    Real diameter = 0;
+    for (size_t c = 0; c < chunks; ++c) {
+      diameter = std::max(diameter, 2 * chunkMax[c]);
+    }
+    diameter = std::max(diameter, static_cast<Real>(1e-3));
+
+    numCells = 1;
+    for (int d = 0; d < Dim; ++d) {
+      origin[d] = lo[d];
+      const Real size = std::max(hi[d] - lo[d], diameter);
+      dims[d] = std::min(maxCellsPerAxis,
+                         std::max(1, static_cast<int>(size / diameter)));
+      invCell[d] = dims[d] / size;
+      numCells *= dims[d];
+    }
+  }
+
+  void radixPass(JobSystem &jobs, size_t n, int shift) {
+    const size_t chunks = JobSystem::chunkCount(n, grain);
+    grow(histogram, chunks * radix);
+    jobs.parallelFor(0, n, grain, [&](size_t b, size_t e, size_t c) {
+      uint32_t *h = histogram.data() + c * radix;
+      std::fill(h, h + radix, 0u);
+      for (size_t i = b; i < e; ++i) {
+        ++h[(keys[i] >> shift) & (radix - 1)];
+      }
+    });
+
+    // exclusive prefix sum, digit major so equal digits keep chunk order
+    uint32_t sum = 0;
+    for (uint32_t digit = 0; digit < radix; ++digit) {
+      for (size_t c = 0; c < chunks; ++c) {
+        uint32_t count = histogram[c * radix + digit];
+        histogram[c * radix + digit] = sum;
+        sum += count;
+      }
+    }
+
+    jobs.parallelFor(0, n, grain, [&](size_t b, size_t e, size_t c) {
+      uint32_t *offset = histogram.data() + c * radix;
+      for (size_t i = b; i < e; ++i) {
+        uint32_t dst = offset[(keys[i] >> shift) & (radix - 1)]++;
+        keysAlt[dst] = keys[i];
+        valuesAlt[dst] = values[i];
+      }
+    });
+    keys.swap(keysAlt);
+    values.swap(valuesAlt);
+  }
+
+  // gather every column through the sorted order, swapping buffers so the
+  // old column becomes the scratch space for the next one; scratch takes
+  // the column's capacity, a state reserved for later spawns keeps it
+  void reorder(JobSystem &jobs, ParticleState<Dim, Real> &s) {
+    const size_t n = s.size();
+    auto gather = [&](std::vector<Real> &column) {
+      scratch.reserve(column.capacity());
+      scratch.resize(n);
+      jobs.parallelFor(0, n, grain, [&](size_t b, size_t e, size_t) {
+        for (size_t k = b; k < e; ++k) {
+          scratch[k] = column[values[k]];
+        }
+      });
+      column.swap(scratch);
+    };
+    for (int d = 0; d < Dim; ++d) {
+      gather(s.pos[d]);
+      gather(s.vel[d]);
+    }
+    gather(s.radius);
+    gather(s.mass);
+
+    scratchId.reserve(s.id.capacity());
+    scratchId.resize(n);
+    jobs.parallelFor(0, n, grain, [&](size_t b, size_t e, size_t) {
+      for (size_t k = b; k < e; ++k) {
+        scratchId[k] = s.id[values[k]];
+      }
+    });
+    s.id.swap(scratchId);
+  }
+};
@@ -0,0 +1,356 @@
+#pragma once
+#include "particles.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+// Checkpoint file, version 1. A fixed 256 byte header followed by one raw
+// array per ParticleState column, each starting on a 4096 byte boundary so a
+// mapped column is page aligned. Values are stored in host byte order, the
+// magic number reads back wrong on a host with the other order. Loading is
+// an mmap plus a header check, the columns are used where they lie.
+struct CheckpointHeader {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t dim;
+  uint32_t realBytes;
+  uint32_t alignment;
+  uint64_t count;
+  uint64_t step;
+  // RandomStream state: spawns draw stream = ball index from seed
+  uint64_t seed;
+  uint64_t nextStream;
+  double halfExtent[3];
+  double gravity[3];
+  double wallRestitution;
+  double ballRestitution;
+  // byte offsets of pos[0..2], vel[0..2], radius, mass, id, 0 when absent
+  uint64_t columns[9];
+  uint64_t fileBytes;
+  uint8_t reserved[56];
+};
+static_assert(sizeof(CheckpointHeader) == 256, "header layout changed");
+
+const uint64_t checkpointMagic = 0x3154504b43424242ull; // "BBBCKPT1"
+const uint32_t checkpointVersion = 1;
+const uint64_t checkpointAlignment = 4096;
+
+// run position stored next to the state
+struct CheckpointInfo {
+  uint64_t step{0};
+  uint64_t seed{0};
+  uint64_t nextStream{0};
+};
+
+// Read only mapping of a checkpoint. Opening costs the same for any size,
+// pages are faulted in when a column is first touched.
+template <int Dim, typename Real> class Checkpoint {
+public:
+  explicit Checkpoint(const std::string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("cannot open checkpoint " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 ||
+        static_cast<size_t>(st.st_size) < sizeof(CheckpointHeader)) {
+      ::close(fd);
+      throw std::runtime_error("checkpoint too short: " + path);
+    }
+    bytes = static_cast<size_t>(st.st_size);
+    base = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+      throw std::runtime_error("cannot map checkpoint " + path);
+    }
+
+    const CheckpointHeader &h = header();
+    const char *problem = nullptr;
+    if (h.magic != checkpointMagic) {
+      problem = "not a checkpoint or wrong byte order";
+    } else if (h.version != checkpointVersion) {
+      problem = "unsupported checkpoint version";
+    } else if (h.dim != Dim || h.realBytes != sizeof(Real)) {
+      problem = "checkpoint has a different Dim or Real";
+    } else if (h.fileBytes > bytes) {
+      problem = "checkpoint is truncated";
+    } else if (!columnsInside(h)) {
+      problem = "checkpoint column outside the file or misaligned";
+    }
+    if (problem) {
+      munmap(base, bytes);
+      throw std::runtime_error(std::string(problem) + ": " + path);
+    }
+  }
+
+  ~Checkpoint() { munmap(base, bytes); }
+
+  Checkpoint(const Checkpoint &) = delete;
+  Checkpoint &operator=(const Checkpoint &) = delete;
+
+  const CheckpointHeader &header() const {
+    return *static_cast<const CheckpointHeader *>(base);
+  }
+  size_t size() const { return header().count; }
+
+  const Real *pos(int d) const { return column<Real>(d); }
+  const Real *vel(int d) const { return column<Real>(3 + d); }
+  const Real *radius() const { return column<Real>(6); }
+  const Real *mass() const { return column<Real>(7); }
+  const uint32_t *id() const { return column<uint32_t>(8); }
+
+  CheckpointInfo info() const {
+    return {header().step, header().seed, header().nextStream};
+  }
+
+  SceneParams<Dim, Real> scene() const {
+    SceneParams<Dim, Real> scene;
+    for (int d = 0; d < Dim; ++d) {
+      scene.halfExtent[d] = static_cast<Real>(header().halfExtent[d]);
+      scene.gravity[d] = static_cast<Real>(header().gravity[d]);
+    }
+    scene.wallRestitution = static_cast<Real>(header().wallRestitution);
+    scene.ballRestitution = static_cast<Real>(header().ballRestitution);
+    return scene;
+  }
+
+  // copies the columns into s, for when the run continues from here
+  void restore(ParticleState<Dim, Real> &s) const {
+    const size_t n = size();
+    for (int d = 0; d < Dim; ++d) {
+      s.pos[d].assign(pos(d), pos(d) + n);
+      s.vel[d].assign(vel(d), vel(d) + n);
+    }
+    s.radius.assign(radius(), radius() + n);
+    s.mass.assign(mass(), mass() + n);
+    s.id.assign(id(), id() + n);
+  }
+
+private:
+  void *base{nullptr};
+  size_t bytes{0};
+
+  // every column this Dim reads lies past the header and inside the mapping
+  bool columnsInside(const CheckpointHeader &h) const {
+    const uint64_t limit = bytes;
+    for (int k = 0; k < 9; ++k) {
+      if (k < 6 && k % 3 >= Dim) {
+        continue; // pos and vel past Dim are absent
+      }
+      const uint64_t width = k == 8 ? sizeof(uint32_t) : sizeof(Real);
+      const uint64_t at = h.columns[k];
+      if (at < sizeof(CheckpointHeader) || at % checkpointAlignment != 0 ||
+          at > limit || h.count > (limit - at) / width) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  template <typename T> const T *column(int k) const {
+    return reinterpret_cast<const T *>(static_cast<const char *>(base) +
+                                       header().columns[k]);
+  }
+};
+
+// Writes checkpoints without stopping the simulation for a copy. submit()
+// forks: the child sees the state as it was at that moment, copy on write,
+// writes it to path.tmp in bounded slices and renames it over path once
+// complete, so a crash mid write never leaves a torn checkpoint behind. The
+// caller pays for the fork, which copies page tables rather than the state,
+// and for the first write to each page afterwards. A background thread
+// waits for the child.
+template <int Dim, typename Real> class CheckpointWriter {
+public:
+  CheckpointWriter() : worker([this] { run(); }) {}
+
+  ~CheckpointWriter() {
+    {
+      std::lock_guard<std::mutex> lock(m);
+      stopping = true;
+    }
+    wake.notify_all();
+    worker.join();
+  }
+
+  // false, without forking, while the previous checkpoint is still writing
+  bool submit(const std::string &path, const ParticleState<Dim, Real> &s,
+              const SceneParams<Dim, Real> &scene, const CheckpointInfo &info) {
+    std::unique_lock<std::mutex> lock(m);
+    if (busy) {
+      return false;
+    }
+    // everything the child needs is built here, it must not allocate
+    Layout layout = plan(s, scene, info);
+    const std::string tmp = path + ".tmp";
+    started = std::chrono::steady_clock::now();
+    const pid_t pid = fork();
+    if (pid == 0) {
+      _exit(write(layout, tmp.c_str(), path.c_str()) ? 0 : 1);
+    }
+    if (pid < 0) {
+      failed = true;
+      writtenBytes = 0;
+      return false;
+    }
+    child = pid;
+    pendingBytes = layout.header.fileBytes;
+    busy = true;
+    lock.unlock();
+    wake.notify_all();
+    return true;
+  }
+
+  // blocks until the last submitted checkpoint is on disk
+  void wait() {
+    std::unique_lock<std::mutex> lock(m);
+    idle.wait(lock, [this] { return !busy; });
+  }
+
+  double lastWriteMs() const { return writeMs; }
+  uint64_t lastBytes() const { return writtenBytes; }
+  bool lastFailed() const { return failed; }
+
+private:
+  static constexpr size_t sliceBytes = size_t(8) << 20;
+
+  struct Layout {
+    CheckpointHeader header;
+    const void *data[9];
+    size_t sizes[9];
+  };
+
+  std::mutex m;
+  std::condition_variable wake, idle;
+  bool busy{false}, stopping{false};
+  pid_t child{-1};
+  uint64_t pendingBytes{0};
+  std::chrono::steady_clock::time_point started;
+
+  double writeMs{0.0};
+  uint64_t writtenBytes{0};
+  bool failed{false};
+  std::thread worker;
+
+  static uint64_t alignUp(uint64_t x) {
+    return (x + checkpointAlignment - 1) / checkpointAlignment *
+           checkpointAlignment;
+  }
+
+  void run() {
+    std::unique_lock<std::mutex> lock(m);
+    for (;;) {
+      wake.wait(lock, [this] { return stopping || busy; });
+      if (!busy) {
+        return;
+      }
+      const pid_t pid = child;
+      lock.unlock();
+      int status = 0;
+      while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+      }
+      lock.lock();
+      failed = !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+      writtenBytes = failed ? 0 : pendingBytes;
+      writeMs = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - started)
+                    .count();
+      busy = false;
+      idle.notify_all();
+    }
+  }
+
+  static Layout plan(const ParticleState<Dim, Real> &s,
+                     const SceneParams<Dim, Real> &scene,
+                     const CheckpointInfo &info) {
+    const size_t n = s.size();
+    Layout l;
+    std::memset(&l, 0, sizeof(l));
+    CheckpointHeader &h = l.header;
+    h.magic = checkpointMagic;
+    h.version = checkpointVersion;
+    h.dim = Dim;
+    h.realBytes = sizeof(Real);
+    h.alignment = checkpointAlignment;
+    h.count = n;
+    h.step = info.step;
+    h.seed = info.seed;
+    h.nextStream = info.nextStream;
+    for (int d = 0; d < Dim; ++d) {
+      h.halfExtent[d] = scene.halfExtent[d];
+      h.gravity[d] = scene.gravity[d];
+    }
+    h.wallRestitution = scene.wallRestitution;
+    h.ballRestitution = scene.ballRestitution;
+
+    for (int d = 0; d < Dim; ++d) {
+      l.data[d] = s.pos[d].data();
+      l.data[3 + d] = s.vel[d].data();
+      l.sizes[d] = l.sizes[3 + d] = n * sizeof(Real);
+    }
+    l.data[6] = s.radius.data();
+    l.data[7] = s.mass.data();
+    l.data[8] = s.id.data();
+    l.sizes[6] = l.sizes[7] = n * sizeof(Real);
+    l.sizes[8] = n * sizeof(uint32_t);
+
+    uint64_t offset = alignUp(sizeof(CheckpointHeader));
+    for (int k = 0; k < 9; ++k) {
+      if (k < 6 && k % 3 >= Dim) {
+        continue;
+      }
+      h.columns[k] = offset;
+      offset = alignUp(offset + l.sizes[k]);
+    }
+    h.fileBytes = offset;
+    return l;
+  }
+
+  // runs in the forked child, system calls only
+  static bool write(const Layout &l, const char *tmp, const char *path) {
+    int fd = ::open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      return false;
+    }
+    const CheckpointHeader &h = l.header;
+    bool ok = ftruncate(fd, static_cast<off_t>(h.fileBytes)) == 0 &&
+              writeAt(fd, &h, sizeof(h), 0);
+    for (int k = 0; ok && k < 9; ++k) {
+      if (h.columns[k]) {
+        ok = writeAt(fd, l.data[k], l.sizes[k], h.columns[k]);
+      }
+    }
+    ok = ::close(fd) == 0 && ok;
+    return ok && std::rename(tmp, path) == 0;
+  }
+
+  // slices keep each syscall short, the page cache absorbs the rest
+  static bool writeAt(int fd, const void *data, size_t bytes, uint64_t at) {
+    const char *p = static_cast<const char *>(data);
+    while (bytes > 0) {
+      ssize_t n = pwrite(fd, p, std::min(bytes, sliceBytes),
+                         static_cast<off_t>(at));
+      if (n <= 0) {
+        return false;
+      }
+      p += n;
+      at += static_cast<uint64_t>(n);
+      bytes -= static_cast<size_t>(n);
+    }
+    return true;
+  }
+};
@@ -0,0 +1,232 @@
+#pragma once
+#include "jobSystem.hpp"
+#include "particles.hpp"
+#include "spscRing.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// one ball contact that exchanged an impulse
+struct CollisionEvent {
+  uint64_t step;
+  double time;
+  uint32_t a, b;   // ball ids, a < b
+  float impulse;   // magnitude, along the normal
+  float normal[3]; // unit, from a to b, z is 0 in 2D
+};
+static_assert(sizeof(CollisionEvent) == 40, "event layout changed");
+
+// Binary event file: "BBEVENT1" | uint32 record bytes | CollisionEvent*
+const char collisionLogMagic[8] = {'B', 'B', 'E', 'V', 'E', 'N', 'T', '1'};
+
+// Opt-in stream of every ball contact. Each worker of the JobSystem that
+// runs the solver pushes into its own preallocated ring, so logging takes
+// no lock and shares no cache line between workers. A background thread
+// drains the rings, sorts each finished step by (a, b) so the file does not
+// depend on which worker saw what, and writes it. A full ring drops the
+// event rather than stalling the solver; dropped() tells how many.
+//
+// Per step: beginStep(), pass sink(s) to ballCollisions, endStep().
+class CollisionLog {
+public:
+  // lanes must cover the feeding JobSystem, pass its size()
+  CollisionLog(const std::string &path, unsigned lanes,
+               double minImpulse = 0.0, size_t laneCapacity = 1 << 16)
+      : minImpulse(minImpulse) {
+    csv = path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+    file = std::fopen(path.c_str(), csv ? "w" : "wb");
+    if (!file) {
+      throw std::runtime_error("cannot create event log " + path);
+    }
+    if (csv) {
+      std::fprintf(file, "step,time,a,b,impulse,nx,ny,nz\n");
+    } else {
+      const uint32_t recordBytes = sizeof(CollisionEvent);
+      std::fwrite(collisionLogMagic, 1, sizeof(collisionLogMagic), file);
+      std::fwrite(&recordBytes, sizeof(recordBytes), 1, file);
+    }
+    for (unsigned k = 0; k < std::max(1u, lanes); ++k) {
+      this->lanes.push_back(std::make_unique<Lane>(laneCapacity));
+    }
+    worker = std::thread([this] { run(); });
+  }
+
+  ~CollisionLog() {
+    {
+      std::lock_guard<std::mutex> lock(m);
+      stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+    std::fclose(file);
+  }
+
+  CollisionLog(const CollisionLog &) = delete;
+  CollisionLog &operator=(const CollisionLog &) = delete;
+
+  // the contact logger the solvers take, logs into this
+  template <int Dim, typename Real> struct Sink {
+    CollisionLog *log;
+    const ParticleState<Dim, Real> *s;
+    void operator()(size_t i, size_t j, Real impulse,
+                    const Real *normal) const {
+      log->record(*s, i, j, impulse, normal);
+    }
+  };
+
+  template <int Dim, typename Real>
+  Sink<Dim, Real> sink(const ParticleState<Dim, Real> &s) {
+    return Sink<Dim, Real>{this, &s};
+  }
+
+  // simulation thread, around the solver
+  void beginStep(uint64_t step, double time) {
+    currentStep = step;
+    currentTime = time;
+  }
+  void endStep() { completed.store(currentStep, std::memory_order_release); }
+
+  // simulation thread, after endStep(), waits until every event is written
+  void drain() {
+    while (written.load() != pushed()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+  // simulation thread, between steps
+  uint64_t pushed() const {
+    uint64_t total = 0;
+    for (const auto &lane : lanes) {
+      total += lane->pushed;
+    }
+    return total;
+  }
+  uint64_t dropped() const {
+    uint64_t total = 0;
+    for (const auto &lane : lanes) {
+      total += lane->dropped;
+    }
+    return total;
+  }
+  uint64_t events() const { return written.load(); }
+
+  // any worker, events below the threshold are left out
+  template <int Dim, typename Real>
+  void record(const ParticleState<Dim, Real> &s, size_t i, size_t j,
+              Real impulse, const Real *normal) {
+    if (impulse < minImpulse) {
+      return;
+    }
+    Lane &lane = *lanes[JobSystem::currentWorker() % lanes.size()];
+    CollisionEvent e;
+    e.step = currentStep;
+    e.time = currentTime;
+    e.a = s.id[i];
+    e.b = s.id[j];
+    float sign = 1.0f;
+    if (e.a > e.b) {
+      std::swap(e.a, e.b);
+      sign = -1.0f;
+    }
+    e.impulse = static_cast<float>(impulse);
+    for (int d = 0; d < 3; ++d) {
+      e.normal[d] = d < Dim ? sign * static_cast<float>(normal[d]) : 0.0f;
+    }
+    if (lane.ring.push(e)) {
+      ++lane.pushed;
+    } else {
+      ++lane.dropped;
+    }
+  }
+
+private:
+  // written by one worker, read by the simulation thread between steps
+  struct alignas(64) Lane {
+    explicit Lane(size_t capacity) : ring(capacity) {}
+    SpscRing<CollisionEvent> ring;
+    uint64_t pushed{0};
+    uint64_t dropped{0};
+  };
+
+  double minImpulse;
+  bool csv{false};
+  std::FILE *file{nullptr};
+  std::vector<std::unique_ptr<Lane>> lanes;
+  uint64_t currentStep{0};
+  double currentTime{0.0};
+  std::atomic<uint64_t> completed{0};
+  std::atomic<uint64_t> written{0};
+
+  std::mutex m;
+  std::condition_variable wake;
+  bool stopping{false};
+  std::thread worker;
+
+  void run() {
+    std::vector<CollisionEvent> pending;
+    CollisionEvent e;
+    for (;;) {
+      // read before draining, every event of a completed step is then in
+      // the rings already
+      const uint64_t done = completed.load(std::memory_order_acquire);
+      bool any = false;
+      for (auto &lane : lanes) {
+        while (lane->ring.pop(e)) {
+          pending.push_back(e);
+          any = true;
+        }
+      }
+      writeUpTo(pending, done);
+      if (any) {
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(m);
+      if (stopping && std::all_of(lanes.begin(), lanes.end(),
+                                  [](const std::unique_ptr<Lane> &l) {
+                                    return l->ring.empty();
+                                  })) {
+        break;
+      }
+      wake.wait_for(lock, std::chrono::milliseconds(2));
+    }
+    writeUpTo(pending, ~uint64_t(0));
+    std::fflush(file);
+  }
+
+  void writeUpTo(std::vector<CollisionEvent> &pending, uint64_t done) {
+    auto end = std::partition(
+        pending.begin(), pending.end(),
+        [done](const CollisionEvent &e) { return e.step <= done; });
+    if (end == pending.begin()) {
+      return;
+    }
+    std::sort(pending.begin(), end,
+              [](const CollisionEvent &x, const CollisionEvent &y) {
+                return std::tie(x.step, x.a, x.b) < std::tie(y.step, y.a, y.b);
+              });
+    const size_t count = static_cast<size_t>(end - pending.begin());
+    if (csv) {
+      for (auto it = pending.begin(); it != end; ++it) {
+        std::fprintf(file, "%llu,%.9g,%u,%u,%.9g,%.7g,%.7g,%.7g\n",
+                     static_cast<unsigned long long>(it->step), it->time,
+                     it->a, it->b, it->impulse, it->normal[0], it->normal[1],
+                     it->normal[2]);
+      }
+    } else {
+      std::fwrite(pending.data(), sizeof(CollisionEvent), count, file);
+    }
+    pending.erase(pending.begin(), end);
+    written.fetch_add(count, std::memory_order_relaxed);
+  }
+};
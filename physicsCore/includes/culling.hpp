@@ -0,0 +1,83 @@
+#pragma once
+#include "jobSystem.hpp"
+#include "particles.hpp"
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// View frustum culling of balls as a parallel phase. Each chunk writes the
+// visible indices into its own buffer and they are joined in chunk order, so
+// the draw order stays stable and no buffer is shared between workers.
+
+// planes (a, b, c, d) facing inwards from a column major view-projection
+// matrix, e.g. glm::value_ptr(projection * view)
+template <typename Real>
+void frustumPlanes(const float *viewProjection, Real planes[6][4]) {
+  auto row = [viewProjection](int r, int c) {
+    return static_cast<Real>(viewProjection[c * 4 + r]);
+  };
+  for (int p = 0; p < 6; ++p) {
+    const int axis = p / 2;
+    const Real sign = p % 2 == 0 ? 1 : -1;
+    Real len = 0;
+    for (int c = 0; c < 4; ++c) {
+      planes[p][c] = row(3, c) + sign * row(axis, c);
+      if (c < 3) {
+        len += planes[p][c] * planes[p][c];
+      }
+    }
+    len = std::sqrt(len);
+    for (int c = 0; c < 4; ++c) {
+      planes[p][c] /= len;
+    }
+  }
+}
+
+template <typename Real> class SphereCuller {
+public:
+  // indices of the balls that intersect the frustum
+  const std::vector<uint32_t> &cull(JobSystem &jobs,
+                                    const ParticleState<3, Real> &s,
+                                    const Real planes[6][4]) {
+    const Real *pos[3] = {s.pos[0].data(), s.pos[1].data(), s.pos[2].data()};
+    return cull(jobs, pos, s.radius.data(), s.size(), planes);
+  }
+
+  // same over bare columns, e.g. ones mapped from another process
+  const std::vector<uint32_t> &cull(JobSystem &jobs, const Real *const pos[3],
+                                    const Real *radius, size_t n,
+                                    const Real planes[6][4]) {
+    const size_t chunks = JobSystem::chunkCount(n, grain);
+    if (chunkVisible.size() < chunks) {
+      chunkVisible.resize(chunks);
+    }
+    jobs.parallelFor(0, n, grain, [&](size_t b, size_t e, size_t c) {
+      std::vector<uint32_t> &out = chunkVisible[c];
+      out.clear();
+      for (size_t i = b; i < e; ++i) {
+        bool inside = true;
+        for (int p = 0; p < 6; ++p) {
+          const Real dist = planes[p][0] * pos[0][i] +
+                            planes[p][1] * pos[1][i] +
+                            planes[p][2] * pos[2][i] + planes[p][3];
+          inside &= dist >= -radius[i];
+        }
+        if (inside) {
+          out.push_back(static_cast<uint32_t>(i));
+        }
+      }
+    });
+
+    visible.clear();
+    for (size_t c = 0; c < chunks; ++c) {
+      visible.insert(visible.end(), chunkVisible[c].begin(),
+                     chunkVisible[c].end());
+    }
+    return visible;
+  }
+
+private:
+  static constexpr size_t grain = 4096;
+  std::vector<std::vector<uint32_t>> chunkVisible;
+  std::vector<uint32_t> visible;
+};
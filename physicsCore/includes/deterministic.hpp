@@ -0,0 +1,222 @@
+#pragma once
+#include "cellGrid.hpp"
+#include "jobSystem.hpp"
+#include "kernels.hpp"
+#include "particles.hpp"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+// Step whose result is bit identical for any number of workers.
+// Ball contacts are solved Jacobi style: each ball reads the state as it was
+// at the start of the pass and sums its own corrections over its neighbours in
+// grid order, so no two jobs write the same ball and nothing depends on which
+// worker ran what. Both sides of a contact compute the same impulse bit for
+// bit, so momentum still balances. Reductions are summed per fixed size chunk
+// and then in chunk order, chunk boundaries never depend on the worker count.
+template <int Dim, typename Real> class DeterministicSim {
+public:
+  CellGrid<Dim, Real> grid;
+
+  // same phases as the fast path, returns the contacts that exchanged impulse
+  template <typename Integrator = SemiImplicitEuler,
+            typename ContactLog = NoContactLog>
+  size_t step(JobSystem &jobs, ParticleState<Dim, Real> &s,
+              const SceneParams<Dim, Real> &scene, Real dt,
+              const ContactLog &log = {}) {
+    updatePhysics<Integrator>(jobs, s, scene, dt);
+    grid.build(jobs, s, scene);
+    return ballCollisions(jobs, s, scene, log);
+  }
+
+  // Contacts go to log from the workers, once each, from the lower index.
+  // The pair loop only counts them, keeping the pairs there slowed every
+  // step by a fifth. Balls that touched a higher index walk their neighbours
+  // again and work the impulse out from the unchanged state.
+  template <typename ContactLog = NoContactLog>
+  size_t ballCollisions(JobSystem &jobs, ParticleState<Dim, Real> &s,
+                        const SceneParams<Dim, Real> &scene,
+                        const ContactLog &log = {}) {
+    constexpr bool logging = !std::is_same<ContactLog, NoContactLog>::value;
+    const size_t n = s.size();
+    for (int d = 0; d < Dim; ++d) {
+      dPos[d].resize(n);
+      dVel[d].resize(n);
+    }
+    chunkCounts.resize(JobSystem::chunkCount(n, grain));
+
+    const Real e = scene.ballRestitution;
+    jobs.parallelFor(0, n, grain, [&](size_t b, size_t end, size_t c) {
+      size_t count = 0;
+      for (size_t i = b; i < end; ++i) {
+        Real dp[Dim]{}, dv[Dim]{};
+        size_t touched = 0;
+        grid.forEachNearby(s, i, [&](uint32_t j) {
+          const bool hit = contact(s, i, j, e, dp, dv);
+          count += hit;
+          if (logging) {
+            touched += hit & (i < j);
+          }
+        });
+        for (int d = 0; d < Dim; ++d) {
+          dPos[d][i] = dp[d];
+          dVel[d][i] = dv[d];
+        }
+        if (touched) {
+          grid.forEachNearby(s, i, [&](uint32_t j) {
+            if (i < j) {
+              logImpulse(s, i, j, e, log);
+            }
+          });
+        }
+      }
+      chunkCounts[c] = count;
+    });
+
+    jobs.parallelFor(0, n, grain, [&](size_t b, size_t end, size_t) {
+      for (int d = 0; d < Dim; ++d) {
+        for (size_t i = b; i < end; ++i) {
+          s.pos[d][i] += dPos[d][i];
+          s.vel[d][i] += dVel[d][i];
+        }
+      }
+    });
+
+    size_t total = 0;
+    for (size_t count : chunkCounts) {
+      total += count;
+    }
+    return total / 2; // every contact was seen from both balls
+  }
+
+  // sum of valueOf(i) over all balls in a fixed order of additions
+  template <typename Fn>
+  double sum(JobSystem &jobs, size_t n, const Fn &valueOf) {
+    chunkSums.resize(JobSystem::chunkCount(n, grain));
+    jobs.parallelFor(0, n, grain, [&](size_t b, size_t e, size_t c) {
+      double partial = 0.0;
+      for (size_t i = b; i < e; ++i) {
+        partial += valueOf(i);
+      }
+      chunkSums[c] = partial;
+    });
+    double total = 0.0;
+    for (double partial : chunkSums) {
+      total += partial;
+    }
+    return total;
+  }
+
+  // FNV-1a of every column, hashed per chunk and folded in chunk order
+  uint64_t hash(JobSystem &jobs, const ParticleState<Dim, Real> &s) {
+    const size_t n = s.size();
+    chunkHashes.resize(JobSystem::chunkCount(n, grain));
+    jobs.parallelFor(0, n, grain, [&](size_t b, size_t e, size_t c) {
+      uint64_t h = fnvBasis;
+      for (int d = 0; d < Dim; ++d) {
+        h = fnv(h, s.pos[d].data() + b, e - b);
+        h = fnv(h, s.vel[d].data() + b, e - b);
+      }
+      h = fnv(h, s.radius.data() + b, e - b);
+      h = fnv(h, s.mass.data() + b, e - b);
+      h = fnv(h, s.id.data() + b, e - b);
+      chunkHashes[c] = h;
+    });
+    uint64_t h = fnvBasis;
+    for (uint64_t chunk : chunkHashes) {
+      h = fnv(h, &chunk, 1);
+    }
+    return h;
+  }
+
+private:
+  static constexpr size_t grain = 4096;
+  static constexpr uint64_t fnvBasis = 14695981039346656037ull;
+  static constexpr uint64_t fnvPrime = 1099511628211ull;
+
+  std::vector<Real> dPos[Dim];
+  std::vector<Real> dVel[Dim];
+  std::vector<size_t> chunkCounts;
+  std::vector<double> chunkSums;
+  std::vector<uint64_t> chunkHashes;
+
+  template <typename T>
+  static uint64_t fnv(uint64_t h, const T *data, size_t count) {
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data);
+    for (size_t k = 0; k < count * sizeof(T); ++k) {
+      h = (h ^ bytes[k]) * fnvPrime;
+    }
+    return h;
+  }
+
+  // resolveContact seen from ball i only, corrections go to dp and dv
+  static bool contact(const ParticleState<Dim, Real> &s, size_t i, size_t j,
+                      Real restitution, Real *dp, Real *dv) {
+    Real delta[Dim];
+    Real dist2 = 0;
+    for (int d = 0; d < Dim; ++d) {
+      delta[d] = s.pos[d][j] - s.pos[d][i];
+      dist2 += delta[d] * delta[d];
+    }
+    const Real sumR = s.radius[i] + s.radius[j];
+    if (dist2 >= sumR * sumR) {
+      return false;
+    }
+    const Real dist = std::sqrt(dist2);
+    if (dist <= static_cast<Real>(1e-4)) {
+      return false;
+    }
+
+    Real normal[Dim];
+    const Real halfOverlap = (sumR - dist) * static_cast<Real>(0.5);
+    Real velAlongNormal = 0;
+    for (int d = 0; d < Dim; ++d) {
+      normal[d] = delta[d] / dist;
+      dp[d] -= normal[d] * halfOverlap;
+      velAlongNormal += (s.vel[d][i] - s.vel[d][j]) * normal[d];
+    }
+    if (velAlongNormal <= 0) {
+      return false;
+    }
+
+    const Real invMassI = 1 / s.mass[i];
+    const Real invMassJ = 1 / s.mass[j];
+    const Real impulse =
+        (1 + restitution) * velAlongNormal / (invMassI + invMassJ);
+    for (int d = 0; d < Dim; ++d) {
+      dv[d] -= impulse * invMassI * normal[d];
+    }
+    return true;
+  }
+
+  // the impulse contact() applied to the pair, if any, handed to log
+  template <typename ContactLog>
+  static void logImpulse(const ParticleState<Dim, Real> &s, size_t i,
+                         size_t j, Real restitution, const ContactLog &log) {
+    Real delta[Dim];
+    Real dist2 = 0;
+    for (int d = 0; d < Dim; ++d) {
+      delta[d] = s.pos[d][j] - s.pos[d][i];
+      dist2 += delta[d] * delta[d];
+    }
+    const Real sumR = s.radius[i] + s.radius[j];
+    const Real dist = std::sqrt(dist2);
+    if (dist2 >= sumR * sumR || dist <= static_cast<Real>(1e-4)) {
+      return;
+    }
+    Real normal[Dim];
+    Real velAlongNormal = 0;
+    for (int d = 0; d < Dim; ++d) {
+      normal[d] = delta[d] / dist;
+      velAlongNormal += (s.vel[d][i] - s.vel[d][j]) * normal[d];
+    }
+    if (velAlongNormal <= 0) {
+      return;
+    }
+    log(i, j,
+        (1 + restitution) * velAlongNormal / (1 / s.mass[i] + 1 / s.mass[j]),
+        normal);
+  }
+};
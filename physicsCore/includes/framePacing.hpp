@@ -0,0 +1,122 @@
+#pragma once
+#include "pipeline.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// How a window hands frames to the screen. vsync waits for the display,
+// uncapped presents at once so a frame costs only its own work, paced holds
+// each frame to targetFps on the CPU side, independent of the display.
+enum class PresentMode { vsync, uncapped, paced };
+
+struct PresentSettings {
+  PresentMode mode{PresentMode::vsync};
+  double targetFps{60.0};
+
+  const char *name() const {
+    return mode == PresentMode::vsync      ? "vsync"
+           : mode == PresentMode::uncapped ? "uncapped"
+                                           : "paced";
+  }
+};
+
+// "vsync", "uncapped" or a frame rate to pace to, nullptr keeps vsync
+inline PresentSettings presentSettingsFrom(const char *arg) {
+  PresentSettings s;
+  if (!arg || std::string(arg) == "vsync") {
+    return s;
+  }
+  if (std::string(arg) == "uncapped") {
+    s.mode = PresentMode::uncapped;
+    return s;
+  }
+  char *end = nullptr;
+  s.targetFps = std::strtod(arg, &end);
+  if (end == arg || *end != '\0' || s.targetFps <= 0.0) {
+    throw std::runtime_error(std::string("present mode must be vsync, "
+                                         "uncapped or a frame rate, not ") +
+                             arg);
+  }
+  s.mode = PresentMode::paced;
+  return s;
+}
+
+// Holds frames to a fixed rate. Sleeps while the deadline is far, then
+// spins the last stretch, since a sleep can overshoot by a scheduler tick.
+class FramePacer {
+public:
+  explicit FramePacer(double fps = 60.0, uint64_t spinNs = 2000000)
+      : periodNs(static_cast<uint64_t>(1e9 / fps)), spinNs(spinNs) {}
+
+  // right before presenting
+  void wait() {
+    uint64_t now = pipelineNowNs();
+    deadline += periodNs;
+    if (deadline + periodNs < now) {
+      deadline = now; // fell a whole frame behind, do not try to catch up
+      return;
+    }
+    if (deadline > now + spinNs) {
+      std::this_thread::sleep_for(
+          std::chrono::nanoseconds(deadline - now - spinNs));
+    }
+    while (pipelineNowNs() < deadline) {
+      std::this_thread::yield();
+    }
+  }
+
+private:
+  uint64_t periodNs;
+  uint64_t spinNs;
+  uint64_t deadline{0};
+};
+
+// Per frame times in ms, reported as percentiles. cpu runs from the end of
+// one present to the start of the next, present is the swap call itself
+// and frame is present to present, pacing waits included.
+class FrameStats {
+public:
+  void add(uint64_t cpuNs, uint64_t presentNs, uint64_t frameNs) {
+    cpu.push_back(cpuNs * 1e-6f);
+    present.push_back(presentNs * 1e-6f);
+    frame.push_back(frameNs * 1e-6f);
+  }
+
+  size_t frames() const { return frame.size(); }
+
+  void report(std::ostream &out, const PresentSettings &settings) const {
+    if (frame.empty()) {
+      return;
+    }
+    out << std::fixed << std::setprecision(2) << "present "
+        << settings.name();
+    if (settings.mode == PresentMode::paced) {
+      out << " at " << settings.targetFps << " fps";
+    }
+    out << ", " << frame.size() << " frames, ms p50/p95/p99\n";
+    line(out, "  cpu     ", cpu);
+    line(out, "  present ", present);
+    line(out, "  frame   ", frame);
+  }
+
+private:
+  std::vector<float> cpu, present, frame;
+
+  static void line(std::ostream &out, const char *label,
+                   std::vector<float> v) {
+    auto at = [&](double q) {
+      const size_t k = std::min(v.size() - 1, static_cast<size_t>(
+                                                  q * (v.size() - 1) + 0.5));
+      std::nth_element(v.begin(), v.begin() + k, v.end());
+      return v[k];
+    };
+    out << label << at(0.50) << " / " << at(0.95) << " / " << at(0.99)
+        << "\n";
+  }
+};
@@ -0,0 +1,105 @@
+#pragma once
+#include "jobSystem.hpp"
+#include "particles.hpp"
+#include "rotation.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Infinite planes that keep balls on their positive side, dot(n, x) >= offset.
+// collide() makes one streaming pass over every ball per plane with selects
+// instead of branches, so each extra collider costs a vectorised sweep.
+template <int Dim, typename Real> struct HalfSpaceColliders {
+  std::vector<Real> normal[Dim];
+  std::vector<Real> offset;
+  std::vector<Real> restitution;
+
+  size_t size() const { return offset.size(); }
+
+  // n must be unit length
+  size_t add(const Real n[Dim], Real off, Real e) {
+    for (int d = 0; d < Dim; ++d) {
+      normal[d].push_back(n[d]);
+    }
+    offset.push_back(off);
+    restitution.push_back(e);
+    return size() - 1;
+  }
+
+  // Plane transform as used by Plane::draw, the mesh lies in local y = 0 so
+  // the world normal is the rotated +y axis through center
+  size_t addPlane(const Real center[3], const Real rotationDegrees[3], Real e) {
+    static_assert(Dim == 3, "plane transforms are 3D");
+    Real rot[3][3];
+    eulerRotation(rotationDegrees, rot);
+    Real n[Dim];
+    Real off = 0;
+    for (int d = 0; d < Dim; ++d) {
+      n[d] = rot[d][1];
+      off += n[d] * center[d];
+    }
+    return add(n, off, e);
+  }
+
+  // Returns the number of ball/plane contacts
+  size_t collide(ParticleState<Dim, Real> &s) const {
+    size_t contacts = 0;
+    for (size_t p = 0; p < size(); ++p) {
+      contacts += collidePlane(s, p, 0, s.size());
+    }
+    return contacts;
+  }
+
+  // each chunk sweeps every plane while its balls are still in cache
+  size_t collide(JobSystem &jobs, ParticleState<Dim, Real> &s) const {
+    std::atomic<size_t> contacts{0};
+    jobs.parallelFor(0, s.size(), grain, [&](size_t b, size_t e, size_t) {
+      size_t local = 0;
+      for (size_t p = 0; p < size(); ++p) {
+        local += collidePlane(s, p, b, e);
+      }
+      contacts += local;
+    });
+    return contacts;
+  }
+
+private:
+  static constexpr size_t grain = 4096;
+
+  size_t collidePlane(ParticleState<Dim, Real> &s, size_t p, size_t begin,
+                      size_t end) const {
+    const Real *r = s.radius.data();
+    Real n[Dim];
+    Real *x[Dim];
+    Real *v[Dim];
+    for (int d = 0; d < Dim; ++d) {
+      n[d] = normal[d][p];
+      x[d] = s.pos[d].data();
+      v[d] = s.vel[d].data();
+    }
+    const Real off = offset[p];
+    const Real bounce = 1 + restitution[p];
+
+    size_t contacts = 0;
+    for (size_t i = begin; i < end; ++i) {
+      Real dist = -off - r[i];
+      Real velAlongNormal = 0;
+      for (int d = 0; d < Dim; ++d) {
+        dist += n[d] * x[d][i];
+        velAlongNormal += n[d] * v[d][i];
+      }
+      // pen < 0 while penetrating, the impulse only cancels approach
+      const Real pen = std::min(dist, static_cast<Real>(0));
+      const Real impulse =
+          pen < 0 ? -bounce * std::min(velAlongNormal, static_cast<Real>(0))
+                  : 0;
+      for (int d = 0; d < Dim; ++d) {
+        x[d][i] -= n[d] * pen;
+        v[d][i] += n[d] * impulse;
+      }
+      contacts += pen < 0;
+    }
+    return contacts;
+  }
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+// Integrator policies for updatePhysics.
+// Each policy advances a position/velocity pair by dt given an acceleration
+// callable accel(position, velocity). They are plain structs with a static
+// step() so the choice is a template argument and costs nothing at runtime.
+// Vec only needs +, += and * by a scalar, so the kernels run them on single
+// SoA components (Vec = Real) and glm vectors work as well.
+
+// position with the old velocity, then velocity (first order, gains energy)
+struct ExplicitEuler {
+  static constexpr const char *name = "explicitEuler";
+  template <typename Vec, typename Real, typename Accel>
+  static void step(Vec &x, Vec &v, Accel accel, Real dt) {
+    Vec a = accel(x, v);
+    x += v * dt;
+    v += a * dt;
+  }
+};
+
+// velocity first, then position with the new velocity (symplectic, the
+// original updatePhysics ordering)
+struct SemiImplicitEuler {
+  static constexpr const char *name = "semiImplicitEuler";
+  template <typename Vec, typename Real, typename Accel>
+  static void step(Vec &x, Vec &v, Accel accel, Real dt) {
+    v += accel(x, v) * dt;
+    x += v * dt;
+  }
+};
+
+// second order, exact for constant acceleration
+struct VelocityVerlet {
+  static constexpr const char *name = "velocityVerlet";
+  template <typename Vec, typename Real, typename Accel>
+  static void step(Vec &x, Vec &v, Accel accel, Real dt) {
+    const Real half = static_cast<Real>(0.5);
+    Vec a0 = accel(x, v);
+    x += v * dt + a0 * (half * dt * dt);
+    Vec a1 = accel(x, v + a0 * dt);
+    v += (a0 + a1) * (half * dt);
+  }
+};
+
+// classic fourth order Runge-Kutta (four acceleration evaluations per step)
+struct RK4 {
+  static constexpr const char *name = "rk4";
+  template <typename Vec, typename Real, typename Accel>
+  static void step(Vec &x, Vec &v, Accel accel, Real dt) {
+    const Real half = static_cast<Real>(0.5) * dt;
+    const Real sixth = dt / static_cast<Real>(6);
+
+    Vec k1x = v;
+    Vec k1v = accel(x, v);
+    Vec k2x = v + k1v * half;
+    Vec k2v = accel(x + k1x * half, k2x);
+    Vec k3x = v + k2v * half;
+    Vec k3v = accel(x + k2x * half, k3x);
+    Vec k4x = v + k3v * dt;
+    Vec k4v = accel(x + k3x * dt, k4x);
+
+    x += (k1x + k2x * static_cast<Real>(2) + k3x * static_cast<Real>(2) + k4x) *
+         sixth;
+    v += (k1v + k2v * static_cast<Real>(2) + k3v * static_cast<Real>(2) + k4v) *
+         sixth;
+  }
+};
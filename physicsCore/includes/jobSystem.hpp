@@ -0,0 +1,295 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+struct JobCounter;
+
+// A unit of work. The callable is stored inline, so a job never allocates;
+// captures must be small and trivially copyable (references, pointers, ints).
+class Job {
+public:
+  Job() = default;
+
+  template <typename Fn>
+  Job(const Fn &fn, JobCounter *counter) : counter(counter) {
+    static_assert(sizeof(Fn) <= sizeof(storage), "job capture is too large");
+    static_assert(std::is_trivially_copyable<Fn>::value &&
+                      std::is_trivially_destructible<Fn>::value,
+                  "capture by reference or pointer");
+    new (storage) Fn(fn);
+    invoke = [](const void *p) { (*static_cast<const Fn *>(p))(); };
+  }
+
+  void operator()() const { invoke(storage); }
+
+  JobCounter *counter{nullptr};
+
+private:
+  void (*invoke)(const void *){nullptr};
+  alignas(16) unsigned char storage[48];
+};
+
+// Number of unfinished jobs. wait() on it, or pass it as the dependency of
+// later jobs so they are only queued once it reaches zero.
+struct JobCounter {
+  std::atomic<int> value{0};
+  std::mutex m;
+  std::vector<Job> waiting;
+};
+
+// Work-stealing scheduler shared by every simulation phase.
+// Each worker owns a deque: it pushes and pops at the back, idle workers steal
+// from the front of the others. The thread that calls wait() runs jobs too, so
+// JobSystem(1) is a plain serial executor.
+class JobSystem {
+public:
+  struct WorkerStats {
+    double busySeconds;
+    double utilisation; // busy time over wall time since resetStats()
+    uint64_t jobs;
+    uint64_t steals;
+  };
+
+  explicit JobSystem(unsigned threadCount = 0) {
+    if (threadCount == 0) {
+      threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (unsigned i = 0; i < threadCount; ++i) {
+      workers.push_back(std::make_unique<Worker>());
+    }
+    resetStats();
+    for (unsigned i = 1; i < threadCount; ++i) {
+      threads.emplace_back([this, i] { workerLoop(i); });
+    }
+  }
+
+  ~JobSystem() {
+    {
+      std::lock_guard<std::mutex> lock(sleepMutex);
+      stop = true;
+    }
+    wake.notify_all();
+    for (auto &t : threads) {
+      t.join();
+    }
+  }
+
+  unsigned size() const { return static_cast<unsigned>(workers.size()); }
+
+  // index of the calling worker, 0 for threads the system does not own
+  static unsigned currentWorker() { return workerIndex(); }
+
+  template <typename Fn>
+  void run(const Fn &fn, JobCounter &done, JobCounter *after = nullptr) {
+    Job job(fn, &done);
+    done.value.fetch_add(1, std::memory_order_relaxed);
+    if (after) {
+      std::lock_guard<std::mutex> lock(after->m);
+      if (after->value.load(std::memory_order_acquire) > 0) {
+        after->waiting.push_back(job);
+        return;
+      }
+    }
+    push(job);
+  }
+
+  // runs queued jobs on the calling thread until counter reaches zero
+  void wait(JobCounter &counter) {
+    const unsigned self = workerIndex() % size();
+    while (counter.value.load(std::memory_order_acquire) > 0) {
+      Job job;
+      if (pop(self, job)) {
+        execute(self, job);
+      } else {
+        std::this_thread::yield();
+      }
+    }
+    // the last finisher still holds the lock while it releases dependents
+    std::lock_guard<std::mutex> lock(counter.m);
+  }
+
+  // fn(begin, end, chunk) for fixed size chunks. Chunk boundaries depend only
+  // on grain, never on the thread count, so phases can keep per chunk output.
+  template <typename Fn>
+  void parallelFor(size_t begin, size_t end, size_t grain, const Fn &fn) {
+    if (end <= begin) {
+      return;
+    }
+    grain = std::max<size_t>(grain, 1);
+    const size_t chunks = chunkCount(end - begin, grain);
+    if (chunks == 1 || size() == 1) {
+      auto start = std::chrono::steady_clock::now();
+      for (size_t c = 0; c < chunks; ++c) {
+        const size_t b = begin + c * grain;
+        fn(b, std::min(end, b + grain), c);
+      }
+      account(workerIndex() % size(), start, chunks);
+      return;
+    }
+    JobCounter done;
+    const Fn *f = &fn;
+    for (size_t c = 0; c < chunks; ++c) {
+      const size_t b = begin + c * grain;
+      const size_t e = std::min(end, b + grain);
+      run([f, b, e, c] { (*f)(b, e, c); }, done);
+    }
+    wait(done);
+  }
+
+  static size_t chunkCount(size_t n, size_t grain) {
+    return (n + grain - 1) / std::max<size_t>(grain, 1);
+  }
+
+  std::vector<WorkerStats> stats() const {
+    const double wall = std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - statsStart)
+                            .count();
+    std::vector<WorkerStats> out;
+    for (auto &w : workers) {
+      WorkerStats s;
+      s.busySeconds = w->busyNs.load(std::memory_order_relaxed) * 1e-9;
+      s.utilisation = wall > 0.0 ? s.busySeconds / wall : 0.0;
+      s.jobs = w->jobsRun.load(std::memory_order_relaxed);
+      s.steals = w->steals.load(std::memory_order_relaxed);
+      out.push_back(s);
+    }
+    return out;
+  }
+
+  void resetStats() {
+    for (auto &w : workers) {
+      w->busyNs = 0;
+      w->jobsRun = 0;
+      w->steals = 0;
+    }
+    statsStart = std::chrono::steady_clock::now();
+  }
+
+  void printStats(std::ostream &out) const {
+    auto all = stats();
+    for (size_t i = 0; i < all.size(); ++i) {
+      out << "worker " << i << ": " << std::fixed << std::setprecision(1)
+          << all[i].utilisation * 100.0 << "% busy, " << all[i].jobs
+          << " jobs, " << all[i].steals << " steals\n";
+    }
+  }
+
+private:
+  struct alignas(64) Worker {
+    std::mutex m;
+    std::deque<Job> queue;
+    std::atomic<uint64_t> busyNs{0};
+    std::atomic<uint64_t> jobsRun{0};
+    std::atomic<uint64_t> steals{0};
+  };
+
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::vector<std::thread> threads;
+  std::chrono::steady_clock::time_point statsStart;
+
+  std::mutex sleepMutex;
+  std::condition_variable wake;
+  std::atomic<int> queued{0};
+  bool stop{false};
+
+  static unsigned &workerIndex() {
+    thread_local unsigned index = 0;
+    return index;
+  }
+
+  void push(const Job &job) {
+    Worker &w = *workers[workerIndex() % size()];
+    {
+      std::lock_guard<std::mutex> lock(w.m);
+      w.queue.push_back(job);
+    }
+    queued.fetch_add(1, std::memory_order_release);
+    wake.notify_one();
+  }
+
+  bool pop(unsigned self, Job &out) {
+    {
+      Worker &w = *workers[self];
+      std::lock_guard<std::mutex> lock(w.m);
+      if (!w.queue.empty()) {
+        out = w.queue.back();
+        w.queue.pop_back();
+        queued.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+    for (unsigned k = 1; k < size(); ++k) {
+      Worker &victim = *workers[(self + k) % size()];
+      std::lock_guard<std::mutex> lock(victim.m);
+      if (!victim.queue.empty()) {
+        out = victim.queue.front();
+        victim.queue.pop_front();
+        queued.fetch_sub(1, std::memory_order_relaxed);
+        workers[self]->steals.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void execute(unsigned self, const Job &job) {
+    auto start = std::chrono::steady_clock::now();
+    job();
+    account(self, start, 1);
+    finish(*job.counter);
+  }
+
+  void account(unsigned self, std::chrono::steady_clock::time_point start,
+               uint64_t jobCount) {
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+    Worker &w = *workers[self];
+    w.busyNs.fetch_add(static_cast<uint64_t>(ns), std::memory_order_relaxed);
+    w.jobsRun.fetch_add(jobCount, std::memory_order_relaxed);
+  }
+
+  void finish(JobCounter &counter) {
+    std::vector<Job> ready;
+    {
+      std::lock_guard<std::mutex> lock(counter.m);
+      if (counter.value.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        ready.swap(counter.waiting);
+      }
+    }
+    for (const Job &job : ready) {
+      push(job);
+    }
+  }
+
+  void workerLoop(unsigned self) {
+    workerIndex() = self;
+    while (true) {
+      Job job;
+      if (pop(self, job)) {
+        execute(self, job);
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(sleepMutex);
+      if (stop) {
+        return;
+      }
+      wake.wait_for(lock, std::chrono::milliseconds(1), [this] {
+        return stop || queued.load(std::memory_order_acquire) > 0;
+      });
+    }
+  }
+};
@@ -0,0 +1,149 @@
+#pragma once
+#include "integrator.hpp"
+#include "jobSystem.hpp"
+#include "particles.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+// Physics kernels over ParticleState. Every loop runs over a fixed Dim so the
+// compiler unrolls the component loop and 2D instantiations do no z work.
+// Per ball kernels take a [begin, end) range so the JobSystem overloads can
+// hand chunks to workers.
+
+// balls per job, large enough to amortise scheduling
+const size_t kernelGrain = 4096;
+
+// gravity is uniform, so each component integrates independently
+template <typename Integrator, int Dim, typename Real>
+void integrate(ParticleState<Dim, Real> &s, const SceneParams<Dim, Real> &scene,
+               Real dt, size_t begin, size_t end) {
+  for (int d = 0; d < Dim; ++d) {
+    Real *x = s.pos[d].data();
+    Real *v = s.vel[d].data();
+    const Real g = scene.gravity[d];
+    auto accel = [g](Real, Real) { return g; };
+    for (size_t i = begin; i < end; ++i) {
+      Integrator::step(x[i], v[i], accel, dt);
+    }
+  }
+}
+
+template <typename Integrator, int Dim, typename Real>
+void integrate(ParticleState<Dim, Real> &s, const SceneParams<Dim, Real> &scene,
+               Real dt) {
+  integrate<Integrator>(s, scene, dt, 0, s.size());
+}
+
+// Wall collision, written with selects instead of branches so it vectorises
+template <int Dim, typename Real>
+void collisionCheck(ParticleState<Dim, Real> &s,
+                    const SceneParams<Dim, Real> &scene, size_t begin,
+                    size_t end) {
+  const Real e = scene.wallRestitution;
+  const Real *r = s.radius.data();
+  for (int d = 0; d < Dim; ++d) {
+    Real *x = s.pos[d].data();
+    Real *v = s.vel[d].data();
+    const Real h = scene.halfExtent[d];
+    for (size_t i = begin; i < end; ++i) {
+      const Real hi = h - r[i];
+      const Real lo = r[i] - h;
+      const Real xi = x[i];
+      const Real speed = std::abs(v[i]) * e;
+      v[i] = xi > hi ? -speed : (xi < lo ? speed : v[i]);
+      x[i] = std::min(std::max(xi, lo), hi);
+    }
+  }
+}
+
+template <int Dim, typename Real>
+void collisionCheck(ParticleState<Dim, Real> &s,
+                    const SceneParams<Dim, Real> &scene) {
+  collisionCheck(s, scene, 0, s.size());
+}
+
+template <typename Integrator = SemiImplicitEuler, int Dim, typename Real>
+void updatePhysics(ParticleState<Dim, Real> &s,
+                   const SceneParams<Dim, Real> &scene, Real dt) {
+  integrate<Integrator>(s, scene, dt);
+  collisionCheck(s, scene);
+}
+
+// integration and walls fused per chunk so each chunk is touched once
+template <typename Integrator = SemiImplicitEuler, int Dim, typename Real>
+void updatePhysics(JobSystem &jobs, ParticleState<Dim, Real> &s,
+                   const SceneParams<Dim, Real> &scene, Real dt) {
+  jobs.parallelFor(0, s.size(), kernelGrain,
+                   [&](size_t begin, size_t end, size_t) {
+                     integrate<Integrator>(s, scene, dt, begin, end);
+                     collisionCheck(s, scene, begin, end);
+                   });
+}
+
+// what the contact solvers report by default: nothing. A logger instead
+// takes (i, j, impulse, normal from i to j) for each impulse it applies.
+struct NoContactLog {
+  template <typename Real>
+  void operator()(size_t, size_t, Real, const Real *) const {}
+};
+
+// Separate an overlapping pair and apply the restitution impulse if they are
+// approaching. Returns true when an impulse was applied.
+template <int Dim, typename Real, typename ContactLog = NoContactLog>
+bool resolveContact(ParticleState<Dim, Real> &s, size_t i, size_t j,
+                    Real restitution, const ContactLog &log = {}) {
+  Real delta[Dim];
+  Real dist2 = 0;
+  for (int d = 0; d < Dim; ++d) {
+    delta[d] = s.pos[d][j] - s.pos[d][i];
+    dist2 += delta[d] * delta[d];
+  }
+  const Real sumR = s.radius[i] + s.radius[j];
+  if (dist2 >= sumR * sumR) {
+    return false;
+  }
+  const Real dist = std::sqrt(dist2);
+  if (dist <= static_cast<Real>(1e-4)) {
+    return false;
+  }
+
+  // normal points from i to j
+  Real normal[Dim];
+  const Real halfOverlap = (sumR - dist) * static_cast<Real>(0.5);
+  Real velAlongNormal = 0;
+  for (int d = 0; d < Dim; ++d) {
+    normal[d] = delta[d] / dist;
+    s.pos[d][i] -= normal[d] * halfOverlap;
+    s.pos[d][j] += normal[d] * halfOverlap;
+    velAlongNormal += (s.vel[d][i] - s.vel[d][j]) * normal[d];
+  }
+  if (velAlongNormal <= 0) {
+    return false; // already separating
+  }
+
+  const Real invMassI = 1 / s.mass[i];
+  const Real invMassJ = 1 / s.mass[j];
+  const Real impulse =
+      (1 + restitution) * velAlongNormal / (invMassI + invMassJ);
+  for (int d = 0; d < Dim; ++d) {
+    s.vel[d][i] -= impulse * invMassI * normal[d];
+    s.vel[d][j] += impulse * invMassJ * normal[d];
+  }
+  log(i, j, impulse, normal);
+  return true;
+}
+
+// Brute force pair loop, returns the number of resolved contacts
+template <int Dim, typename Real>
+size_t ballCollisions(ParticleState<Dim, Real> &s,
+                      const SceneParams<Dim, Real> &scene) {
+  size_t contacts = 0;
+  const size_t n = s.size();
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t j = i + 1; j < n; ++j) {
+      contacts += resolveContact(s, i, j, scene.ballRestitution);
+    }
+  }
+  return contacts;
+}
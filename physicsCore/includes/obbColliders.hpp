@@ -0,0 +1,275 @@
+#pragma once
+#include "jobSystem.hpp"
+#include "particles.hpp"
+#include "rotation.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Static oriented boxes that balls bounce off.
+// Boxes are stored SoA and bucketed once into a uniform grid (CSR layout).
+// Each frame collide() first matches every ball to the boxes in the cells it
+// overlaps, then the narrowphase streams over that candidate pair list. A ball
+// only ever tests the boxes near it, however many boxes are registered.
+// With a JobSystem each chunk of balls gathers and resolves its own pairs; a
+// pair only writes its ball, so chunks never touch the same data.
+template <typename Real> class ObbColliders {
+public:
+  std::vector<Real> center[3];
+  std::vector<Real> axis[3][3]; // axis[k][d] is component d of local axis k
+  std::vector<Real> halfExtent[3];
+  Real restitution{1};
+
+  size_t size() const { return center[0].size(); }
+
+  // same rotation order as Box::draw (x, then y, then z), in degrees
+  size_t add(const Real c[3], const Real rotationDegrees[3], const Real h[3]) {
+    Real rot[3][3];
+    eulerRotation(rotationDegrees, rot);
+    for (int d = 0; d < 3; ++d) {
+      center[d].push_back(c[d]);
+      halfExtent[d].push_back(h[d]);
+      for (int k = 0; k < 3; ++k) {
+        axis[k][d].push_back(rot[d][k]);
+      }
+    }
+    return size() - 1;
+  }
+
+  // bucket the boxes into the grid, call once after the last add()
+  void build() {
+    const size_t n = size();
+    cellStart.assign(2, 0);
+    cellBoxes.clear();
+    if (n == 0) {
+      return;
+    }
+
+    // world space AABB of every box, the cell is sized to the largest one
+    Real lo[3], hi[3];
+    Real largest = 0;
+    for (int d = 0; d < 3; ++d) {
+      lo[d] = center[d][0];
+      hi[d] = center[d][0];
+    }
+    std::vector<Real> aabb[3];
+    for (int d = 0; d < 3; ++d) {
+      aabb[d].resize(n);
+    }
+    for (size_t b = 0; b < n; ++b) {
+      for (int d = 0; d < 3; ++d) {
+        Real e = 0;
+        for (int k = 0; k < 3; ++k) {
+          e += std::abs(axis[k][d][b]) * halfExtent[k][b];
+        }
+        aabb[d][b] = e;
+        lo[d] = std::min(lo[d], center[d][b] - e);
+        hi[d] = std::max(hi[d], center[d][b] + e);
+        largest = std::max(largest, e);
+      }
+    }
+    cellSize = std::max(largest * 2, static_cast<Real>(1e-3));
+    size_t total = 1;
+    for (int d = 0; d < 3; ++d) {
+      origin[d] = lo[d];
+      cells[d] = std::min(
+          maxCellsPerAxis,
+          std::max(1, static_cast<int>(std::ceil((hi[d] - lo[d]) / cellSize))));
+      total *= cells[d];
+    }
+    // a capped axis needs bigger cells to still reach hi
+    for (int d = 0; d < 3; ++d) {
+      cellSize = std::max(cellSize, (hi[d] - lo[d]) / cells[d]);
+    }
+
+    // count, prefix sum, then fill
+    cellStart.assign(total + 1, 0);
+    forEachCell(n, aabb, [&](size_t cell, size_t) { ++cellStart[cell + 1]; });
+    for (size_t c = 0; c < total; ++c) {
+      cellStart[c + 1] += cellStart[c];
+    }
+    cellBoxes.resize(cellStart[total]);
+    std::vector<uint32_t> cursor(cellStart.begin(), cellStart.end() - 1);
+    forEachCell(n, aabb, [&](size_t cell, size_t b) {
+      cellBoxes[cursor[cell]++] = static_cast<uint32_t>(b);
+    });
+  }
+
+  // Returns the number of ball/box contacts resolved
+  size_t collide(ParticleState<3, Real> &s) {
+    if (chunkPairs.empty()) {
+      chunkPairs.resize(1);
+    }
+    return collideRange(s, 0, s.size(), chunkPairs[0]);
+  }
+
+  size_t collide(JobSystem &jobs, ParticleState<3, Real> &s) {
+    const size_t chunks = JobSystem::chunkCount(s.size(), grain);
+    if (chunkPairs.size() < chunks) {
+      chunkPairs.resize(chunks);
+    }
+    std::atomic<size_t> contacts{0};
+    jobs.parallelFor(0, s.size(), grain, [&](size_t b, size_t e, size_t c) {
+      contacts += collideRange(s, b, e, chunkPairs[c]);
+    });
+    return contacts;
+  }
+
+private:
+  static constexpr int maxCellsPerAxis = 256;
+  static constexpr size_t grain = 1024;
+
+  // candidate pairs, kept between frames so steady state does not allocate
+  struct PairBuffer {
+    std::vector<uint32_t> ball;
+    std::vector<uint32_t> box;
+  };
+
+  Real cellSize{1};
+  Real origin[3]{};
+  int cells[3]{1, 1, 1};
+  std::vector<uint32_t> cellStart;
+  std::vector<uint32_t> cellBoxes;
+  std::vector<PairBuffer> chunkPairs;
+
+  int cellCoord(Real x, int d) const {
+    int c = static_cast<int>(std::floor((x - origin[d]) / cellSize));
+    return std::min(std::max(c, 0), cells[d] - 1);
+  }
+
+  size_t cellIndex(int x, int y, int z) const {
+    return (static_cast<size_t>(z) * cells[1] + y) * cells[0] + x;
+  }
+
+  template <typename Fn>
+  void forEachCell(size_t n, const std::vector<Real> aabb[3], Fn fn) const {
+    for (size_t b = 0; b < n; ++b) {
+      int c0[3], c1[3];
+      for (int d = 0; d < 3; ++d) {
+        c0[d] = cellCoord(center[d][b] - aabb[d][b], d);
+        c1[d] = cellCoord(center[d][b] + aabb[d][b], d);
+      }
+      for (int z = c0[2]; z <= c1[2]; ++z)
+        for (int y = c0[1]; y <= c1[1]; ++y)
+          for (int x = c0[0]; x <= c1[0]; ++x)
+            fn(cellIndex(x, y, z), b);
+    }
+  }
+
+  size_t collideRange(ParticleState<3, Real> &s, size_t begin, size_t end,
+                      PairBuffer &pairs) {
+    gatherCandidates(s, begin, end, pairs);
+    size_t contacts = 0;
+    for (size_t p = 0; p < pairs.ball.size(); ++p) {
+      contacts += resolve(s, pairs.ball[p], pairs.box[p]);
+    }
+    return contacts;
+  }
+
+  void gatherCandidates(const ParticleState<3, Real> &s, size_t begin,
+                        size_t end, PairBuffer &pairs) const {
+    std::vector<uint32_t> &pairBall = pairs.ball;
+    std::vector<uint32_t> &pairBox = pairs.box;
+    pairBall.clear();
+    pairBox.clear();
+    if (cellBoxes.empty()) {
+      return;
+    }
+    for (size_t i = begin; i < end; ++i) {
+      const Real r = s.radius[i];
+      int c0[3], c1[3];
+      bool outside = false;
+      for (int d = 0; d < 3; ++d) {
+        const Real p = s.pos[d][i];
+        const Real gridEnd = origin[d] + cellSize * cells[d];
+        outside |= p + r < origin[d] || p - r > gridEnd;
+        c0[d] = cellCoord(p - r, d);
+        c1[d] = cellCoord(p + r, d);
+      }
+      if (outside) {
+        continue;
+      }
+
+      const size_t first = pairBox.size();
+      for (int z = c0[2]; z <= c1[2]; ++z)
+        for (int y = c0[1]; y <= c1[1]; ++y)
+          for (int x = c0[0]; x <= c1[0]; ++x) {
+            const size_t cell = cellIndex(x, y, z);
+            for (uint32_t k = cellStart[cell]; k < cellStart[cell + 1]; ++k) {
+              pairBox.push_back(cellBoxes[k]);
+            }
+          }
+
+      // a box spanning several cells shows up once per cell
+      std::sort(pairBox.begin() + first, pairBox.end());
+      pairBox.erase(std::unique(pairBox.begin() + first, pairBox.end()),
+                    pairBox.end());
+      pairBall.resize(pairBox.size(), static_cast<uint32_t>(i));
+    }
+  }
+
+  // sphere vs OBB: closest point in box space, or the shallowest face when
+  // the center is already inside
+  bool resolve(ParticleState<3, Real> &s, size_t i, size_t b) {
+    const Real r = s.radius[i];
+    Real q[3], clamped[3];
+    bool inside = true;
+    for (int k = 0; k < 3; ++k) {
+      q[k] = 0;
+      for (int d = 0; d < 3; ++d) {
+        q[k] += (s.pos[d][i] - center[d][b]) * axis[k][d][b];
+      }
+      const Real h = halfExtent[k][b];
+      clamped[k] = std::min(std::max(q[k], -h), h);
+      inside &= clamped[k] == q[k];
+    }
+
+    Real localNormal[3] = {0, 0, 0};
+    Real depth;
+    if (!inside) {
+      Real dist2 = 0;
+      for (int k = 0; k < 3; ++k) {
+        localNormal[k] = q[k] - clamped[k];
+        dist2 += localNormal[k] * localNormal[k];
+      }
+      if (dist2 >= r * r) {
+        return false;
+      }
+      const Real dist = std::sqrt(dist2);
+      for (int k = 0; k < 3; ++k) {
+        localNormal[k] /= dist;
+      }
+      depth = r - dist;
+    } else {
+      int best = 0;
+      Real bestGap = halfExtent[0][b] - std::abs(q[0]);
+      for (int k = 1; k < 3; ++k) {
+        const Real gap = halfExtent[k][b] - std::abs(q[k]);
+        if (gap < bestGap) {
+          bestGap = gap;
+          best = k;
+        }
+      }
+      localNormal[best] = q[best] < 0 ? -1 : 1;
+      depth = bestGap + r;
+    }
+
+    Real normal[3];
+    Real velAlongNormal = 0;
+    for (int d = 0; d < 3; ++d) {
+      normal[d] = localNormal[0] * axis[0][d][b] +
+                  localNormal[1] * axis[1][d][b] +
+                  localNormal[2] * axis[2][d][b];
+      s.pos[d][i] += normal[d] * depth;
+      velAlongNormal += s.vel[d][i] * normal[d];
+    }
+    if (velAlongNormal < 0) {
+      for (int d = 0; d < 3; ++d) {
+        s.vel[d][i] -= (1 + restitution) * velAlongNormal * normal[d];
+      }
+    }
+    return true;
+  }
+};
@@ -0,0 +1,138 @@
+#pragma once
+#include "particles.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Names one pooled ball. The slot is also the ball's id in the state; the
+// generation tells it apart from the balls that held the slot before.
+struct ParticleHandle {
+  uint32_t slot{0};
+  uint32_t generation{0}; // even is never live, so {} names nothing
+
+  bool operator==(const ParticleHandle &o) const {
+    return slot == o.slot && generation == o.generation;
+  }
+  bool operator!=(const ParticleHandle &o) const { return !(*this == o); }
+};
+
+// ParticleState for balls that come and go at any rate: emitters, sinks,
+// merges. The state stays dense so every kernel runs on it unchanged; a
+// destroyed ball's place goes to the last ball and its slot onto a free
+// list for the next spawn. All storage is taken up front, so spawn and
+// destroy never touch the heap, and a handle is checked with one compare.
+//
+// The grid may reorder state() freely. The id column carries the slot, and
+// the slot to index map is rebuilt the first time a lookup finds it stale.
+template <int Dim, typename Real> class ParticlePool {
+public:
+  static constexpr size_t npos = ~size_t(0);
+
+  explicit ParticlePool(size_t capacity)
+      : generation(capacity, 0), index(capacity, npos) {
+    s.reserve(capacity);
+    freeSlots.reserve(capacity);
+    for (size_t k = capacity; k-- > 0;) {
+      freeSlots.push_back(static_cast<uint32_t>(k)); // slot 0 goes first
+    }
+  }
+
+  ParticleState<Dim, Real> &state() { return s; }
+  const ParticleState<Dim, Real> &state() const { return s; }
+  size_t size() const { return s.size(); }
+  size_t capacity() const { return generation.size(); }
+  bool full() const { return freeSlots.empty(); }
+
+  // a handle that is never alive when every slot is taken
+  ParticleHandle spawn(const Real *p, const Real *v, Real r, Real m) {
+    if (freeSlots.empty()) {
+      return ParticleHandle{};
+    }
+    const uint32_t slot = freeSlots.back();
+    freeSlots.pop_back();
+    const size_t i = s.add(p, v, r, m);
+    s.id[i] = slot;
+    index[slot] = i;
+    return ParticleHandle{slot, ++generation[slot]};
+  }
+
+  // ball i of another state, e.g. one spawnRandom filled
+  ParticleHandle spawnCopy(const ParticleState<Dim, Real> &from, size_t i) {
+    Real p[Dim], v[Dim];
+    for (int d = 0; d < Dim; ++d) {
+      p[d] = from.pos[d][i];
+      v[d] = from.vel[d][i];
+    }
+    return spawn(p, v, from.radius[i], from.mass[i]);
+  }
+
+  bool alive(ParticleHandle h) const {
+    return h.slot < generation.size() && generation[h.slot] == h.generation &&
+           (h.generation & 1);
+  }
+
+  // the handle of the ball at index i of state()
+  ParticleHandle handleAt(size_t i) const {
+    return ParticleHandle{s.id[i], generation[s.id[i]]};
+  }
+
+  // where the ball is in state() now, npos for a stale handle
+  size_t indexOf(ParticleHandle h) {
+    if (!alive(h)) {
+      return npos;
+    }
+    if (index[h.slot] >= s.size() || s.id[index[h.slot]] != h.slot) {
+      reindex();
+    }
+    return index[h.slot];
+  }
+
+  // false when the ball is gone already
+  bool destroy(ParticleHandle h) {
+    const size_t i = indexOf(h);
+    if (i == npos) {
+      return false;
+    }
+    destroyAt(i);
+    return true;
+  }
+
+  // The ball at index i. The last ball moves into i, so a sweep that
+  // destroys as it goes runs from the back.
+  void destroyAt(size_t i) {
+    const uint32_t slot = s.id[i];
+    const size_t last = s.size() - 1;
+    if (i != last) {
+      for (int d = 0; d < Dim; ++d) {
+        s.pos[d][i] = s.pos[d][last];
+        s.vel[d][i] = s.vel[d][last];
+      }
+      s.radius[i] = s.radius[last];
+      s.mass[i] = s.mass[last];
+      s.id[i] = s.id[last];
+      index[s.id[i]] = i;
+    }
+    for (int d = 0; d < Dim; ++d) {
+      s.pos[d].pop_back();
+      s.vel[d].pop_back();
+    }
+    s.radius.pop_back();
+    s.mass.pop_back();
+    s.id.pop_back();
+    index[slot] = npos;
+    ++generation[slot];
+    freeSlots.push_back(slot);
+  }
+
+private:
+  ParticleState<Dim, Real> s;
+  std::vector<uint32_t> generation; // odd while the slot holds a ball
+  std::vector<size_t> index;
+  std::vector<uint32_t> freeSlots;
+
+  void reindex() {
+    for (size_t i = 0; i < s.size(); ++i) {
+      index[s.id[i]] = i;
+    }
+  }
+};
@@ -0,0 +1,62 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Ball state shared by every app, one column per component (SoA).
+// Dim and Real are template arguments so a 2D float run never touches a z
+// column and a double precision run only changes the type alias.
+template <int Dim, typename Real> struct ParticleState {
+  static_assert(Dim == 2 || Dim == 3, "only 2D and 3D are supported");
+  static constexpr int dim = Dim;
+  using real = Real;
+
+  std::vector<Real> pos[Dim];
+  std::vector<Real> vel[Dim];
+  std::vector<Real> radius;
+  std::vector<Real> mass;
+  // stable identity, follows a ball when the columns are reordered
+  std::vector<uint32_t> id;
+
+  size_t size() const { return radius.size(); }
+
+  void reserve(size_t n) {
+    for (int d = 0; d < Dim; ++d) {
+      pos[d].reserve(n);
+      vel[d].reserve(n);
+    }
+    radius.reserve(n);
+    mass.reserve(n);
+    id.reserve(n);
+  }
+
+  void clear() {
+    for (int d = 0; d < Dim; ++d) {
+      pos[d].clear();
+      vel[d].clear();
+    }
+    radius.clear();
+    mass.clear();
+    id.clear();
+  }
+
+  // returns the index of the new ball
+  size_t add(const Real *p, const Real *v, Real r, Real m) {
+    for (int d = 0; d < Dim; ++d) {
+      pos[d].push_back(p[d]);
+      vel[d].push_back(v[d]);
+    }
+    id.push_back(static_cast<uint32_t>(size()));
+    radius.push_back(r);
+    mass.push_back(m);
+    return size() - 1;
+  }
+};
+
+// Container and material parameters, the container is centered on the origin
+template <int Dim, typename Real> struct SceneParams {
+  Real halfExtent[Dim]{};
+  Real gravity[Dim]{};
+  Real wallRestitution{1};
+  Real ballRestitution{1};
+};
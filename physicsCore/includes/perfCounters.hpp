@@ -0,0 +1,142 @@
+#pragma once
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Hardware counters for the user space of the calling thread and of every
+// thread it starts afterwards, so open them before the JobSystem. Each
+// counter opens on its own: a machine without one still reports the rest,
+// and when the kernel refuses them all (perf_event_paranoid, a container, a
+// VM without a PMU) every total reads as missing and why() says so.
+//
+// resume() and pause() bracket the code to count and may be repeated, so
+// several kernels of one loop can each keep their own PerfCounters.
+class PerfCounters {
+public:
+  enum Counter {
+    cycles,
+    instructions,
+    l1Misses,
+    llcMisses,
+    branchMisses,
+    counterCount
+  };
+
+  struct Totals {
+    double value[counterCount]{};
+    bool valid[counterCount]{};
+  };
+
+  PerfCounters() {
+#ifdef __linux__
+    const uint64_t l1Read = PERF_COUNT_HW_CACHE_L1D |
+                            PERF_COUNT_HW_CACHE_OP_READ << 8 |
+                            PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+    const uint32_t types[counterCount] = {
+        PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+        PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE};
+    const uint64_t configs[counterCount] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, l1Read,
+        PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+    for (int c = 0; c < counterCount; ++c) {
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = types[c];
+      attr.config = configs[c];
+      attr.disabled = 1;
+      attr.inherit = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format =
+          PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+      fd[c] = static_cast<int>(
+          syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+      if (fd[c] < 0 && reason.empty()) {
+        reason = std::string(name(c)) + ": " + std::strerror(errno);
+        if (errno == EACCES || errno == EPERM) {
+          reason += ", see /proc/sys/kernel/perf_event_paranoid";
+        }
+      }
+    }
+#else
+    reason = "perf_event_open needs Linux";
+#endif
+  }
+
+  ~PerfCounters() {
+#ifdef __linux__
+    for (int f : fd) {
+      if (f >= 0) {
+        close(f);
+      }
+    }
+#endif
+  }
+
+  PerfCounters(const PerfCounters &) = delete;
+  PerfCounters &operator=(const PerfCounters &) = delete;
+
+  static const char *name(int c) {
+    static const char *names[counterCount] = {
+        "cycles", "instructions", "L1D read misses", "LLC misses",
+        "branch misses"};
+    return names[c];
+  }
+
+  bool any() const {
+    for (int f : fd) {
+      if (f >= 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // why the first counter that failed did, empty when all opened
+  const std::string &why() const { return reason; }
+
+  void resume() { control(true); }
+  void pause() { control(false); }
+
+  // counts since construction, scaled up when the PMU was shared
+  Totals read() const {
+    Totals t;
+#ifdef __linux__
+    for (int c = 0; c < counterCount; ++c) {
+      uint64_t v[3];
+      if (fd[c] < 0 ||
+          ::read(fd[c], v, sizeof(v)) != static_cast<ssize_t>(sizeof(v))) {
+        continue;
+      }
+      // enabled but never scheduled says nothing
+      t.valid[c] = v[2] > 0 || v[1] == 0;
+      t.value[c] = v[2] > 0 ? static_cast<double>(v[0]) * v[1] / v[2] : 0.0;
+    }
+#endif
+    return t;
+  }
+
+private:
+  int fd[counterCount] = {-1, -1, -1, -1, -1};
+  std::string reason;
+
+  void control(bool on) {
+#ifdef __linux__
+    for (int f : fd) {
+      if (f >= 0) {
+        ioctl(f, on ? PERF_EVENT_IOC_ENABLE : PERF_EVENT_IOC_DISABLE, 0);
+      }
+    }
+#else
+    static_cast<void>(on);
+#endif
+  }
+};
@@ -0,0 +1,150 @@
+#pragma once
+#include "particles.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <thread>
+
+// Hand off between a simulation thread and a render thread.
+// The simulation fills the back slot and publish()es it, the renderer read()s
+// the newest published slot. Neither side ever waits on the other: a slow
+// renderer skips snapshots, a slow simulation shows the same one twice.
+template <typename T> class TripleBuffer {
+public:
+  T &writeBuffer() { return slots[back]; }
+
+  void publish() {
+    uint8_t prev = middle.exchange(back | freshBit, std::memory_order_acq_rel);
+    back = prev & indexMask;
+  }
+
+  // latest published value, stays valid until the next read()
+  const T &read() {
+    if (middle.load(std::memory_order_acquire) & freshBit) {
+      uint8_t prev = middle.exchange(front, std::memory_order_acq_rel);
+      front = prev & indexMask;
+    }
+    return slots[front];
+  }
+
+private:
+  static constexpr uint8_t freshBit = 4;
+  static constexpr uint8_t indexMask = 3;
+
+  T slots[3];
+  uint8_t back{0};  // simulation thread only
+  uint8_t front{1}; // render thread only
+  std::atomic<uint8_t> middle{2};
+};
+
+inline uint64_t pipelineNowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Immutable copy of what the renderer needs, velocities and masses stay behind
+template <int Dim, typename Real> struct Snapshot {
+  ParticleState<Dim, Real> state;
+  uint64_t step{0};
+  uint64_t publishedNs{0};
+
+  // copies into the existing columns, so no allocation once warmed up
+  void capture(const ParticleState<Dim, Real> &s, uint64_t stepIndex) {
+    for (int d = 0; d < Dim; ++d) {
+      state.pos[d].assign(s.pos[d].begin(), s.pos[d].end());
+    }
+    state.radius.assign(s.radius.begin(), s.radius.end());
+    state.id.assign(s.id.begin(), s.id.end());
+    step = stepIndex;
+    publishedNs = pipelineNowNs();
+  }
+};
+
+// Latency is how old a snapshot is when it is drawn, overlap is the share of
+// draw time during which the simulation thread was stepping.
+class PipelineMetrics {
+public:
+  // simulation thread
+  void beginStep() {
+    version.fetch_add(1);
+    stepStart.store(pipelineNowNs());
+    version.fetch_add(1);
+  }
+  void endStep() {
+    version.fetch_add(1);
+    simBusyNs.store(simBusyNs.load() + pipelineNowNs() - stepStart.load());
+    stepStart.store(0);
+    version.fetch_add(1);
+    steps.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // render thread
+  void beginDraw() { simAtDrawStart = simBusyNow(drawStart); }
+  void endDraw(const uint64_t snapshotPublishedNs) {
+    uint64_t now = 0;
+    overlapNs += simBusyNow(now) - simAtDrawStart;
+    drawNs += now - drawStart;
+    if (snapshotPublishedNs != 0) {
+      uint64_t age = drawStart - std::min(drawStart, snapshotPublishedNs);
+      latencyNs += age;
+      maxLatencyNs = std::max(maxLatencyNs, age);
+      ++latencyFrames;
+    }
+    ++frames;
+  }
+
+  double averageLatencyMs() const {
+    return latencyFrames ? latencyNs * 1e-6 / latencyFrames : 0.0;
+  }
+  double overlapRatio() const {
+    return drawNs ? static_cast<double>(overlapNs) / drawNs : 0.0;
+  }
+
+  void report(std::ostream &out) const {
+    double wall = (pipelineNowNs() - created) * 1e-9;
+    out << std::fixed << std::setprecision(2) << "frames " << frames << " ("
+        << frames / wall << " fps), sim steps " << steps.load() << " ("
+        << steps.load() / wall << "/s)\n"
+        << "snapshot latency avg " << averageLatencyMs() << " ms, max "
+        << maxLatencyNs * 1e-6 << " ms\n"
+        << "physics overlapping draw " << overlapRatio() * 100.0 << "%\n";
+  }
+
+private:
+  const uint64_t created{pipelineNowNs()};
+
+  // stepStart and simBusyNs change together, odd version while they do
+  std::atomic<uint64_t> version{0};
+  std::atomic<uint64_t> stepStart{0};
+  std::atomic<uint64_t> simBusyNs{0};
+  std::atomic<uint64_t> steps{0};
+
+  uint64_t drawStart{0};
+  uint64_t simAtDrawStart{0};
+  uint64_t drawNs{0};
+  uint64_t overlapNs{0};
+  uint64_t latencyNs{0};
+  uint64_t maxLatencyNs{0};
+  uint64_t latencyFrames{0};
+  uint64_t frames{0};
+
+  // Simulation busy time up to now, which is stored in t, counting a step
+  // still in flight. Reads again if a step began or ended meanwhile, so the
+  // pair and the clock all describe one moment.
+  uint64_t simBusyNow(uint64_t &t) const {
+    uint64_t total, since, seen;
+    do {
+      while ((seen = version.load()) & 1) {
+        std::this_thread::yield();
+      }
+      total = simBusyNs.load();
+      since = stepStart.load();
+      t = pipelineNowNs();
+    } while (version.load() != seen);
+    return total + (since != 0 && t > since ? t - since : 0);
+  }
+};
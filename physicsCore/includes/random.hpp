@@ -0,0 +1,116 @@
+#pragma once
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+// Counter based random numbers (Philox4x32-10, Salmon et al. 2011).
+// A draw is a pure function of (seed, stream, index), so any number of
+// threads can generate disjoint streams, or disjoint parts of one stream,
+// without sharing state, and the results never depend on who ran first.
+
+inline void philox4x32(const uint32_t counter[4], const uint32_t key[2],
+                       uint32_t out[4]) {
+  uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+  uint32_t k0 = key[0], k1 = key[1];
+  for (int round = 0; round < 10; ++round) {
+    const uint64_t p0 = static_cast<uint64_t>(0xD2511F53u) * c0;
+    const uint64_t p1 = static_cast<uint64_t>(0xCD9E8D57u) * c2;
+    c0 = static_cast<uint32_t>(p1 >> 32) ^ c1 ^ k0;
+    c1 = static_cast<uint32_t>(p1);
+    c2 = static_cast<uint32_t>(p0 >> 32) ^ c3 ^ k1;
+    c3 = static_cast<uint32_t>(p0);
+    k0 += 0x9E3779B9u;
+    k1 += 0xBB67AE85u;
+  }
+  out[0] = c0;
+  out[1] = c1;
+  out[2] = c2;
+  out[3] = c3;
+}
+
+// [0, 1) from the top bits of a word, exact in float and double
+template <typename Real> Real unitReal(uint32_t word) {
+  return static_cast<Real>(word >> 8) * static_cast<Real>(1.0 / 16777216.0);
+}
+
+// one independent sequence, identified by a seed and a stream number
+class RandomStream {
+public:
+  RandomStream(uint64_t seed, uint64_t stream) {
+    key[0] = static_cast<uint32_t>(seed);
+    key[1] = static_cast<uint32_t>(seed >> 32);
+    counter[2] = static_cast<uint32_t>(stream);
+    counter[3] = static_cast<uint32_t>(stream >> 32);
+  }
+
+  uint32_t next() {
+    if (used == 4) {
+      philox4x32(counter, key, block);
+      if (++counter[0] == 0) {
+        ++counter[1];
+      }
+      used = 0;
+    }
+    return block[used++];
+  }
+
+  template <typename Real> Real uniform(Real a, Real b) {
+    return a + (b - a) * unitReal<Real>(next());
+  }
+
+  // Bulk draw of n uniforms. Blocks are independent, so the loop has no
+  // carried state and the compiler can vectorise the Philox rounds. Starts
+  // at the next whole block of the stream.
+  template <typename Real> void fill(Real *out, size_t n, Real a, Real b) {
+    const uint64_t first =
+        counter[0] | static_cast<uint64_t>(counter[1]) << 32;
+    const size_t blocks = n / 4;
+    for (size_t k = 0; k < blocks; ++k) {
+      uint32_t c[4] = {static_cast<uint32_t>(first + k),
+                       static_cast<uint32_t>((first + k) >> 32), counter[2],
+                       counter[3]};
+      uint32_t words[4];
+      philox4x32(c, key, words);
+      for (int lane = 0; lane < 4; ++lane) {
+        out[4 * k + lane] = a + (b - a) * unitReal<Real>(words[lane]);
+      }
+    }
+    const uint64_t after = first + blocks;
+    counter[0] = static_cast<uint32_t>(after);
+    counter[1] = static_cast<uint32_t>(after >> 32);
+    used = 4;
+    for (size_t i = 4 * blocks; i < n; ++i) {
+      out[i] = uniform(a, b);
+    }
+  }
+
+private:
+  uint32_t key[2]{};
+  uint32_t counter[4]{};
+  uint32_t block[4]{};
+  int used{4};
+};
+
+// spawned balls use their index as stream number, other users of a seed
+// (colors, jitter, ...) take streams from here up
+const uint64_t firstFreeStream = uint64_t(1) << 63;
+
+// "--flag value" from the command line, nullptr when absent
+inline const char *argValue(int argc, char **argv, const char *flag) {
+  for (int i = 1; i + 1 < argc; ++i) {
+    if (std::strcmp(argv[i], flag) == 0) {
+      return argv[i + 1];
+    }
+  }
+  return nullptr;
+}
+
+// "--seed N" from the command line, otherwise a fresh seed from the system
+inline uint64_t seedFromArgs(int argc, char **argv) {
+  if (const char *seed = argValue(argc, argv, "--seed")) {
+    return std::strtoull(seed, nullptr, 10);
+  }
+  std::random_device device;
+  return static_cast<uint64_t>(device()) << 32 | device();
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include "jobSystem.hpp"
+#include "pipeline.hpp"
+#include "trajectory.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Plays a recorded trajectory instead of simulating. The render thread asks
+// for a frame with seek(), a decoder thread brings the reader there and
+// publishes the result through the same TripleBuffer hand off the live
+// simulation uses, so a long seek shows the previous frame instead of
+// stalling the draw loop.
+template <int Dim, typename Real> class ReplayPlayer {
+public:
+  explicit ReplayPlayer(const std::string &path, unsigned threads = 0)
+      : reader(path), jobs(threads), worker([this] { run(); }) {}
+
+  ~ReplayPlayer() {
+    {
+      std::lock_guard<std::mutex> lock(m);
+      stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+  }
+
+  ReplayPlayer(const ReplayPlayer &) = delete;
+  ReplayPlayer &operator=(const ReplayPlayer &) = delete;
+
+  size_t frameCount() const { return reader.frameCount(); }
+  const TrajectoryHeader &info() const { return reader.info(); }
+
+  // render thread
+  void seek(size_t frame) {
+    frame = std::min(frame, frameCount() - 1);
+    if (target.exchange(frame) != frame) {
+      wake.notify_one();
+    }
+  }
+  size_t requested() const { return target.load(); }
+  const Snapshot<Dim, Real> &read() { return snapshots.read(); }
+  // once the first frame is out, which may hold no balls at all
+  bool ready() const { return published.load(); }
+
+  // decoder time of the last seek, deltas only when stepping forward
+  double lastSeekMs() const { return seekMs.load(); }
+
+private:
+  TrajectoryReader<Dim, Real> reader;
+  JobSystem jobs;
+  TripleBuffer<Snapshot<Dim, Real>> snapshots;
+  std::atomic<size_t> target{0};
+  std::atomic<double> seekMs{0.0};
+  std::atomic<bool> published{false};
+  size_t shown{~size_t(0)};
+
+  std::mutex m;
+  std::condition_variable wake;
+  bool stopping{false};
+  std::thread worker;
+
+  void run() {
+    for (;;) {
+      const size_t k = target.load();
+      if (k == shown) {
+        std::unique_lock<std::mutex> lock(m);
+        if (stopping) {
+          return;
+        }
+        // the timeout covers a seek that lands before the wait
+        wake.wait_for(lock, std::chrono::milliseconds(5));
+        continue;
+      }
+      auto start = std::chrono::steady_clock::now();
+      reader.seek(jobs, k);
+      Snapshot<Dim, Real> &out = snapshots.writeBuffer();
+      reader.fill(jobs, out.state);
+      out.step = reader.step(k);
+      out.publishedNs = pipelineNowNs();
+      snapshots.publish();
+      published = true;
+      shown = k;
+      seekMs = std::chrono::duration<double, std::milli>(
+                   std::chrono::steady_clock::now() - start)
+                   .count();
+    }
+  }
+};
+
+// Playback position in frames. While a scrub key is held the position moves
+// scrubSpeed times faster in that direction, paused or not.
+struct ReplayClock {
+  double frame{0.0};
+  double framesPerSecond{60.0};
+  double scrubSpeed{4.0};
+  bool playing{true};
+
+  // scrub is -1, 0 or 1, returns the frame to show
+  size_t advance(double dt, int scrub, size_t frameCount) {
+    if (scrub != 0) {
+      frame += scrub * scrubSpeed * framesPerSecond * dt;
+    } else if (playing) {
+      frame += framesPerSecond * dt;
+    }
+    const double last = static_cast<double>(frameCount - 1);
+    frame = std::min(std::max(frame, 0.0), last);
+    return static_cast<size_t>(frame);
+  }
+};
@@ -0,0 +1,557 @@
+#pragma once
+#include "jobSystem.hpp"
+#include "particles.hpp"
+#include "pipeline.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Lossless column codec for rewind snapshots. Values are coded in blocks of
+// rewindBlock: each value is XORed with the one before it in the block and
+// its leading zero bytes are dropped, two 4 bit byte counts sharing a control
+// byte. Neighbouring balls of a cell sorted state often share sign, exponent
+// and the top of the mantissa. A block that would not shrink is stored raw
+// behind a zero mode byte.
+const size_t rewindBlock = 4096;
+
+template <typename T>
+using RewindBits =
+    typename std::conditional<sizeof(T) == 8, uint64_t, uint32_t>::type;
+
+// a block stored raw, what encodeRewindBlock falls back to
+template <typename T>
+void storeRewindBlock(const T *v, size_t n, std::vector<uint8_t> &out) {
+  out.push_back(0);
+  const uint8_t *raw = reinterpret_cast<const uint8_t *>(v);
+  out.insert(out.end(), raw, raw + n * sizeof(T));
+}
+
+template <typename T>
+void encodeRewindBlock(const T *v, size_t n, std::vector<uint8_t> &out) {
+  using Bits = RewindBits<T>;
+  const size_t start = out.size();
+  out.push_back(1);
+  Bits prev = 0;
+  for (size_t i = 0; i < n; i += 2) {
+    Bits x[2] = {0, 0};
+    int kept[2] = {0, 0};
+    for (size_t k = 0; k < 2 && i + k < n; ++k) {
+      Bits bits;
+      std::memcpy(&bits, v + i + k, sizeof(T));
+      x[k] = bits ^ prev;
+      prev = bits;
+      for (Bits rest = x[k]; rest; rest >>= 8) {
+        ++kept[k];
+      }
+    }
+    out.push_back(static_cast<uint8_t>(kept[0] | kept[1] << 4));
+    for (int k = 0; k < 2; ++k) {
+      for (int b = 0; b < kept[k]; ++b) {
+        out.push_back(static_cast<uint8_t>(x[k] >> (8 * b)));
+      }
+    }
+  }
+  if (out.size() - start > n * sizeof(T)) {
+    out.resize(start);
+    storeRewindBlock(v, n, out);
+  }
+}
+
+// returns the position after the block
+template <typename T>
+const uint8_t *decodeRewindBlock(const uint8_t *in, T *v, size_t n) {
+  using Bits = RewindBits<T>;
+  if (*in++ == 0) {
+    std::memcpy(v, in, n * sizeof(T));
+    return in + n * sizeof(T);
+  }
+  Bits prev = 0;
+  for (size_t i = 0; i < n; i += 2) {
+    const uint8_t control = *in++;
+    for (size_t k = 0; k < 2 && i + k < n; ++k) {
+      const int kept = k ? control >> 4 : control & 15;
+      Bits x = 0;
+      for (int b = 0; b < kept; ++b) {
+        x |= static_cast<Bits>(*in++) << (8 * b);
+      }
+      prev ^= x;
+      std::memcpy(v + i + k, &prev, sizeof(T));
+    }
+  }
+  return in;
+}
+
+// In memory history of a live simulation for watching it again. Every
+// interval steps the state is copied aside and compressed a few blocks per
+// step over the next half interval, so no single step pays for it. Radius
+// and mass never change and are kept once by id. Once the snapshots outgrow
+// the budget the oldest are dropped. Steps between snapshots are
+// resimulated, see RewindPlayer.
+template <int Dim, typename Real> class RewindBuffer {
+public:
+  explicit RewindBuffer(size_t budgetBytes = size_t(64) << 20,
+                        uint64_t interval = 120)
+      : budget(budgetBytes), interval(std::max<uint64_t>(interval, 1)) {}
+
+  RewindBuffer(const RewindBuffer &) = delete;
+  RewindBuffer &operator=(const RewindBuffer &) = delete;
+
+  // simulation thread, after every step
+  void record(const ParticleState<Dim, Real> &s, uint64_t step) {
+    if (step % interval == 0) {
+      if (encoding) {
+        encodeBlocks(~size_t(0)); // fell behind, finish the old one first
+      }
+      stage(s, step);
+    }
+    if (encoding) {
+      encodeBlocks(blocksPerStep);
+    }
+  }
+
+  // Simulation thread. Stores this state at once and uncompressed, so it
+  // costs about two copies, e.g. where a rewind starts so its first frame
+  // needs no resimulation. Nothing happens when it is stored already.
+  void mark(const ParticleState<Dim, Real> &s, uint64_t step) {
+    if (encoding) {
+      encodeBlocks(~size_t(0));
+    }
+    {
+      std::lock_guard<std::mutex> lock(m);
+      if (!entries.empty() && entries.back().step >= step) {
+        return;
+      }
+    }
+    stage(s, step);
+    encodeBlocks(~size_t(0), true);
+  }
+
+  uint64_t snapshotInterval() const { return interval; }
+
+  // oldest step that can be restored, false while nothing is stored
+  bool firstStep(uint64_t &step) const {
+    std::lock_guard<std::mutex> lock(m);
+    if (entries.empty()) {
+      return false;
+    }
+    step = entries.front().step;
+    return true;
+  }
+
+  // the oldest snapshot after step, false when there is none yet
+  bool nextStep(uint64_t step, uint64_t &next) const {
+    std::lock_guard<std::mutex> lock(m);
+    auto it = std::upper_bound(
+        entries.begin(), entries.end(), step,
+        [](uint64_t k, const Entry &e) { return k < e.step; });
+    if (it == entries.end()) {
+      return false;
+    }
+    next = it->step;
+    return true;
+  }
+
+  size_t snapshots() const {
+    std::lock_guard<std::mutex> lock(m);
+    return entries.size();
+  }
+  size_t bytes() const {
+    std::lock_guard<std::mutex> lock(m);
+    return storedBytes;
+  }
+  // what plain copies of the stored states would take
+  size_t rawBytes() const {
+    std::lock_guard<std::mutex> lock(m);
+    return storedRaw;
+  }
+
+  // Any thread. Loads the newest snapshot at or before step into out and
+  // returns its step, or returns false when step is older than the buffer.
+  bool restore(uint64_t step, ParticleState<Dim, Real> &out,
+               uint64_t &restored) const {
+    std::lock_guard<std::mutex> lock(m);
+    auto it = std::upper_bound(
+        entries.begin(), entries.end(), step,
+        [](uint64_t k, const Entry &e) { return k < e.step; });
+    if (it == entries.begin()) {
+      return false;
+    }
+    const Entry &e = *(it - 1);
+    resize(out, e.count);
+    const uint8_t *in = e.bytes.data();
+    for (int c = 0; c < e.columns; ++c) {
+      for (size_t b = 0; b < e.count; b += rewindBlock) {
+        const size_t n = std::min(rewindBlock, e.count - b);
+        column(out, c,
+               [&](auto *v) { in = decodeRewindBlock(in, v + b, n); });
+      }
+    }
+    if (e.columns == 2 * Dim + 1) {
+      for (size_t i = 0; i < e.count; ++i) {
+        out.radius[i] = staticRadius[out.id[i]];
+        out.mass[i] = staticMass[out.id[i]];
+      }
+    }
+    restored = e.step;
+    return true;
+  }
+
+private:
+  static constexpr size_t ballBytes =
+      (2 * Dim + 2) * sizeof(Real) + sizeof(uint32_t);
+
+  struct Entry {
+    uint64_t step;
+    size_t count;
+    int columns; // 2 Dim + 1 when radius and mass come from the id tables
+    std::vector<uint8_t> bytes;
+  };
+
+  size_t budget;
+  uint64_t interval;
+  mutable std::mutex m; // entries and statics, taken briefly by the writer
+  std::deque<Entry> entries;
+  size_t storedBytes{0}, storedRaw{0};
+  std::vector<Real> staticRadius, staticMass;
+
+  // simulation thread only
+  ParticleState<Dim, Real> staged;
+  Entry pending;
+  bool encoding{false};
+  size_t nextBlock{0}, totalBlocks{0}, blocksPerStep{1};
+
+  static void resize(ParticleState<Dim, Real> &s, size_t n) {
+    for (int d = 0; d < Dim; ++d) {
+      s.pos[d].resize(n);
+      s.vel[d].resize(n);
+    }
+    s.radius.resize(n);
+    s.mass.resize(n);
+    s.id.resize(n);
+  }
+
+  void stage(const ParticleState<Dim, Real> &s, uint64_t step) {
+    const size_t n = s.size();
+    for (int d = 0; d < Dim; ++d) {
+      staged.pos[d].assign(s.pos[d].begin(), s.pos[d].end());
+      staged.vel[d].assign(s.vel[d].begin(), s.vel[d].end());
+    }
+    staged.id.assign(s.id.begin(), s.id.end());
+
+    if (staticRadius.empty()) {
+      std::lock_guard<std::mutex> lock(m);
+      staticRadius.assign(n, Real(0));
+      staticMass.assign(n, Real(0));
+      for (size_t i = 0; i < n && s.id[i] < n; ++i) {
+        staticRadius[s.id[i]] = s.radius[i];
+        staticMass[s.id[i]] = s.mass[i];
+      }
+    }
+    bool fromTables = true;
+    for (size_t i = 0; i < n && fromTables; ++i) {
+      fromTables = s.id[i] < staticRadius.size() &&
+                   staticRadius[s.id[i]] == s.radius[i] &&
+                   staticMass[s.id[i]] == s.mass[i];
+    }
+    if (!fromTables) {
+      staged.radius.assign(s.radius.begin(), s.radius.end());
+      staged.mass.assign(s.mass.begin(), s.mass.end());
+    }
+
+    pending.step = step;
+    pending.count = n;
+    pending.columns = fromTables ? 2 * Dim + 1 : 2 * Dim + 3;
+    pending.bytes.clear();
+    const size_t perColumn = (n + rewindBlock - 1) / rewindBlock;
+    totalBlocks = perColumn * pending.columns;
+    const size_t steps = std::max<uint64_t>(interval / 2, 1);
+    blocksPerStep = (totalBlocks + steps - 1) / steps;
+    nextBlock = 0;
+    encoding = true;
+  }
+
+  void encodeBlocks(size_t count, bool raw = false) {
+    const size_t perColumn = (pending.count + rewindBlock - 1) / rewindBlock;
+    for (; count > 0 && nextBlock < totalBlocks; --count, ++nextBlock) {
+      const int c = static_cast<int>(nextBlock / perColumn);
+      const size_t b = nextBlock % perColumn * rewindBlock;
+      const size_t n = std::min(rewindBlock, pending.count - b);
+      column(staged, c, [&](const auto *v) {
+        if (raw) {
+          storeRewindBlock(v + b, n, pending.bytes);
+        } else {
+          encodeRewindBlock(v + b, n, pending.bytes);
+        }
+      });
+    }
+    if (nextBlock == totalBlocks) {
+      finish();
+    }
+  }
+
+  void finish() {
+    encoding = false;
+    std::lock_guard<std::mutex> lock(m);
+    storedBytes += pending.bytes.size();
+    storedRaw += pending.count * ballBytes;
+    entries.push_back(std::move(pending));
+    pending = Entry();
+    // the newest always stays, even past the budget
+    while (entries.size() > 1 && storedBytes > budget) {
+      const Entry &old = entries.front();
+      storedBytes -= old.bytes.size();
+      storedRaw -= old.count * ballBytes;
+      entries.pop_front();
+    }
+  }
+
+  // fn(first value) of column c: pos, vel, id, then radius and mass
+  template <typename State, typename Fn>
+  static void column(State &s, int c, const Fn &fn) {
+    if (c < Dim) {
+      fn(s.pos[c].data());
+    } else if (c < 2 * Dim) {
+      fn(s.vel[c - Dim].data());
+    } else if (c == 2 * Dim) {
+      fn(s.id.data());
+    } else {
+      fn((c == 2 * Dim + 1 ? s.radius : s.mass).data());
+    }
+  }
+};
+
+// Shows any step between the oldest snapshot and the live one. The render
+// thread asks with seek(); a worker restores the snapshot before it and
+// resimulates up to the step asked for, keeping states along the way within
+// cacheBytes, so scrubbing back and forth inside an interval costs a few
+// steps at most. Whenever no seek is waiting the worker finishes that
+// interval and then builds the neighbouring one on the side the last seek
+// moved to, a step at a time, so scrubbing across a snapshot swaps it in
+// instead of stalling for a whole interval. Frames come out through a
+// TripleBuffer as in ReplayPlayer.
+template <int Dim, typename Real> class RewindPlayer {
+public:
+  // must repeat the live step exactly, step is the one being simulated
+  using StepFn =
+      std::function<void(JobSystem &, ParticleState<Dim, Real> &, uint64_t)>;
+
+  RewindPlayer(const RewindBuffer<Dim, Real> &buffer, StepFn step,
+               size_t cacheBytes = size_t(64) << 20, unsigned threads = 1)
+      : buffer(buffer), stepFn(std::move(step)), cacheBytes(cacheBytes),
+        jobs(threads), worker([this] { run(); }) {}
+
+  ~RewindPlayer() {
+    {
+      std::lock_guard<std::mutex> lock(m);
+      stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+  }
+
+  RewindPlayer(const RewindPlayer &) = delete;
+  RewindPlayer &operator=(const RewindPlayer &) = delete;
+
+  // render thread
+  void seek(uint64_t step) {
+    if (target.exchange(step) != step) {
+      wake.notify_one();
+    }
+  }
+  const Snapshot<Dim, Real> &read() { return snapshots.read(); }
+  uint64_t shownStep() const { return shownAt.load(); }
+
+  // worker time of the last seek
+  double lastSeekMs() const { return seekMs.load(); }
+
+private:
+  static constexpr uint64_t none = ~uint64_t(0);
+
+  // one interval from a snapshot on, states every spacing steps
+  struct Segment {
+    uint64_t start{none}, end{none};
+    uint64_t spacing{1};
+    std::vector<ParticleState<Dim, Real>> cache;
+    size_t cached{0};
+    ParticleState<Dim, Real> work; // the state after step built
+    uint64_t built{0};
+  };
+
+  const RewindBuffer<Dim, Real> &buffer;
+  StepFn stepFn;
+  size_t cacheBytes;
+  JobSystem jobs;
+  TripleBuffer<Snapshot<Dim, Real>> snapshots;
+  std::atomic<uint64_t> target{none};
+  std::atomic<uint64_t> shownAt{none};
+  std::atomic<double> seekMs{0.0};
+
+  // worker only
+  Segment shown, ahead;
+  bool backward{true};
+  ParticleState<Dim, Real> current;
+  uint64_t currentStep{none};
+
+  std::mutex m;
+  std::condition_variable wake;
+  bool stopping{false};
+  std::thread worker;
+
+  void run() {
+    for (;;) {
+      const uint64_t k = target.load();
+      if (k == shownAt.load() || k == none) {
+        if (prefetch()) {
+          continue;
+        }
+        std::unique_lock<std::mutex> lock(m);
+        if (stopping) {
+          return;
+        }
+        wake.wait_for(lock, std::chrono::milliseconds(5));
+        continue;
+      }
+      auto start = std::chrono::steady_clock::now();
+      if (shownAt.load() != none) {
+        backward = k < shownAt.load();
+      }
+      if (!bring(k)) {
+        shownAt = k; // older than the buffer, keep the last frame
+        continue;
+      }
+      Snapshot<Dim, Real> &out = snapshots.writeBuffer();
+      out.capture(current, k);
+      snapshots.publish();
+      shownAt = k;
+      seekMs = std::chrono::duration<double, std::milli>(
+                   std::chrono::steady_clock::now() - start)
+                   .count();
+    }
+  }
+
+  // an interval reaches the next snapshot, the newest runs on past its end
+  bool covers(const Segment &seg, uint64_t k) const {
+    uint64_t next = 0;
+    return seg.start != none && k >= seg.start &&
+           (!buffer.nextStep(seg.start, next) || k < next);
+  }
+
+  // leaves the state after step k in current
+  bool bring(uint64_t k) {
+    if (!covers(shown, k)) {
+      if (covers(ahead, k)) {
+        std::swap(shown, ahead);
+      } else if (!begin(shown, k)) {
+        return false;
+      }
+      currentStep = none;
+    }
+    // only as far as k, prefetch() builds the rest of the interval later
+    if (k > shown.built) {
+      extend(shown, k - shown.built);
+      if (shown.built == k) {
+        current = shown.work;
+        currentStep = k;
+      }
+    }
+    // forward from what is shown when that is nearer than the cached state
+    const size_t w =
+        std::min<size_t>((k - shown.start) / shown.spacing, shown.cached - 1);
+    const uint64_t fromCache = shown.start + w * shown.spacing;
+    if (currentStep == none || currentStep > k || currentStep < fromCache) {
+      current = shown.cache[w];
+      currentStep = fromCache;
+    }
+    while (currentStep < k) {
+      stepFn(jobs, current, ++currentStep);
+    }
+    return true;
+  }
+
+  // One step more of what the scrub direction reaches first: the rest of
+  // the shown interval or the neighbouring one. False when all is built.
+  bool prefetch() {
+    if (shown.start == none) {
+      return false;
+    }
+    const bool unfinished = shown.built + 1 < shown.end;
+    if (unfinished && !backward) {
+      extend(shown, 1);
+      return true;
+    }
+    if (neighbour()) {
+      return true;
+    }
+    if (unfinished) {
+      extend(shown, 1);
+      return true;
+    }
+    return false;
+  }
+
+  bool neighbour() {
+    uint64_t k;
+    if (backward) {
+      if (shown.start == 0) {
+        return false;
+      }
+      k = shown.start - 1;
+    } else if (!buffer.nextStep(shown.start, k)) {
+      return false;
+    }
+    if (!covers(ahead, k)) {
+      return begin(ahead, k);
+    }
+    if (ahead.built + 1 < ahead.end) {
+      extend(ahead, 1);
+      return true;
+    }
+    return false;
+  }
+
+  // restores the snapshot at or before k into seg, nothing resimulated yet
+  bool begin(Segment &seg, uint64_t k) {
+    uint64_t restored = 0;
+    if (!buffer.restore(k, seg.work, restored)) {
+      seg.start = none;
+      return false;
+    }
+    const uint64_t interval = buffer.snapshotInterval();
+    const size_t stateBytes =
+        seg.work.size() * ((2 * Dim + 2) * sizeof(Real) + sizeof(uint32_t));
+    // shown and ahead share the cache
+    const size_t budget = std::max<size_t>(cacheBytes / 2, 1);
+    seg.spacing =
+        std::max<uint64_t>(1, (interval * stateBytes + budget - 1) / budget);
+    seg.cache.resize((interval + seg.spacing - 1) / seg.spacing);
+    seg.cache[0] = seg.work;
+    seg.cached = 1;
+    uint64_t next = 0;
+    seg.start = restored;
+    seg.end = buffer.nextStep(restored, next)
+                  ? std::min(next, restored + interval)
+                  : restored + interval;
+    seg.built = restored;
+    return true;
+  }
+
+  // up to steps more steps of seg, true once the interval is complete
+  bool extend(Segment &seg, uint64_t steps) {
+    for (; steps > 0 && seg.built + 1 < seg.end; --steps) {
+      stepFn(jobs, seg.work, ++seg.built);
+      if ((seg.built - seg.start) % seg.spacing == 0) {
+        seg.cache[seg.cached++] = seg.work;
+      }
+    }
+    return seg.built + 1 >= seg.end;
+  }
+};
@@ -0,0 +1,30 @@
+#pragma once
+#include <cmath>
+
+// Rotation matrix for Euler angles in degrees, applied x then y then z the
+// way Box::draw and Plane::draw build their model matrix. out is row major,
+// so column k is where local axis k ends up in world space.
+template <typename Real>
+void eulerRotation(const Real degrees[3], Real out[3][3]) {
+  const Real toRad = static_cast<Real>(3.14159265358979323846 / 180.0);
+  Real c[3], s[3];
+  for (int a = 0; a < 3; ++a) {
+    c[a] = std::cos(degrees[a] * toRad);
+    s[a] = std::sin(degrees[a] * toRad);
+  }
+  const Real rx[3][3] = {{1, 0, 0}, {0, c[0], -s[0]}, {0, s[0], c[0]}};
+  const Real ry[3][3] = {{c[1], 0, s[1]}, {0, 1, 0}, {-s[1], 0, c[1]}};
+  const Real rz[3][3] = {{c[2], -s[2], 0}, {s[2], c[2], 0}, {0, 0, 1}};
+  Real rxy[3][3];
+  for (int r = 0; r < 3; ++r) {
+    for (int k = 0; k < 3; ++k) {
+      rxy[r][k] = rx[r][0] * ry[0][k] + rx[r][1] * ry[1][k] + rx[r][2] * ry[2][k];
+    }
+  }
+  for (int r = 0; r < 3; ++r) {
+    for (int k = 0; k < 3; ++k) {
+      out[r][k] =
+          rxy[r][0] * rz[0][k] + rxy[r][1] * rz[1][k] + rxy[r][2] * rz[2][k];
+    }
+  }
+}
@@ -0,0 +1,331 @@
+#pragma once
+#include "particles.hpp"
+#include "spawn.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Scenario file, one "key = value" per line, '#' starts a comment.
+// Per axis values are space separated, a single number sets every axis:
+//
+//   name = rain
+//   dim = 3
+//   count = 100000
+//   halfExtent = 200
+//   gravity = 0 -9.8 0
+//   radius = 5 25          # min max, a single number for a fixed size
+//
+// A comma separated value lists alternatives and the file describes every
+// combination, the first listed key varying slowest:
+//
+//   count = 10000, 100000, 1000000
+//   threads = 1, 2, 4
+//
+// Keys the file leaves out keep the defaults the caller passes in, so an app
+// only overrides what the file mentions.
+struct Scenario {
+  std::string name{"default"};
+  std::string label; // swept key=value pairs of this combination
+  int dim{3};
+  bool doublePrecision{false};
+  size_t count{1000};
+  double radiusMin{5}, radiusMax{25};
+  double massMin{5}, massMax{100};
+  double speedMin[3]{0, 0, 0}, speedMax[3]{70, 70, 70};
+  double halfExtent[3]{200, 200, 200};
+  double spawnExtent[3]{-1, -1, -1}; // negative: halfExtent - radiusMax
+  double gravity[3]{0, -9.8, 0};
+  double wallRestitution{1}, ballRestitution{1};
+  // run settings for headlessSim, the apps step in real time and take the
+  // seed from --seed
+  int steps{600};
+  double dt{1.0 / 60.0};
+  unsigned threads{0}; // 0 is one per hardware thread
+  uint64_t seed{42};
+};
+
+inline double scenarioNumber(const std::string &text) {
+  const char *begin = text.c_str();
+  char *end = nullptr;
+  double v = std::strtod(begin, &end);
+  if (end == begin || *end != '\0') {
+    throw std::runtime_error("not a number '" + text + "'");
+  }
+  return v;
+}
+
+// counts, steps and threads: a whole number from 0 up to max
+inline double scenarioWhole(const std::string &text, double max) {
+  double v = scenarioNumber(text);
+  if (v < 0 || v > max || v != std::floor(v)) {
+    throw std::runtime_error("expected a whole number from 0 to " +
+                             std::to_string(static_cast<uint64_t>(max)) +
+                             ", got '" + text + "'");
+  }
+  return v;
+}
+
+inline double scenarioRestitution(const std::string &text) {
+  double v = scenarioNumber(text);
+  if (!(v >= 0 && v <= 1)) {
+    throw std::runtime_error("expected a value from 0 to 1, got '" + text +
+                             "'");
+  }
+  return v;
+}
+
+inline std::vector<double> scenarioNumbers(const std::string &text) {
+  std::istringstream in(text);
+  std::vector<double> out;
+  std::string word;
+  while (in >> word) {
+    out.push_back(scenarioNumber(word));
+  }
+  if (out.empty()) {
+    throw std::runtime_error("missing value");
+  }
+  return out;
+}
+
+inline void scenarioAxes(const std::string &text, double *out,
+                         bool positive = false) {
+  std::vector<double> v = scenarioNumbers(text);
+  if (v.size() > 3) {
+    throw std::runtime_error("expected 1, 2 or 3 values, got '" + text + "'");
+  }
+  for (double x : v) {
+    if (positive && !(x > 0)) {
+      throw std::runtime_error("expected values above 0, got '" + text + "'");
+    }
+  }
+  for (int d = 0; d < 3; ++d) {
+    out[d] = v[std::min<size_t>(d, v.size() - 1)];
+  }
+}
+
+// radius and mass: 0 < min <= max
+inline void scenarioRange(const std::string &text, double &lo, double &hi) {
+  std::vector<double> v = scenarioNumbers(text);
+  if (v.size() > 2 || v.back() < v.front()) {
+    throw std::runtime_error("expected 'min max', got '" + text + "'");
+  }
+  if (!(v.front() > 0)) {
+    throw std::runtime_error("expected values above 0, got '" + text + "'");
+  }
+  lo = v.front();
+  hi = v.back();
+}
+
+inline std::string scenarioTrim(const std::string &s) {
+  const size_t b = s.find_first_not_of(" \t\r");
+  const size_t e = s.find_last_not_of(" \t\r");
+  return b == std::string::npos ? std::string() : s.substr(b, e - b + 1);
+}
+
+using ScenarioSetter = std::function<void(Scenario &, const std::string &)>;
+using ScenarioKey = std::pair<std::string, ScenarioSetter>;
+
+inline const std::vector<ScenarioKey> &scenarioKeys() {
+  static const std::vector<ScenarioKey> table = {
+      {"name", [](Scenario &s, const std::string &v) { s.name = v; }},
+      {"dim",
+       [](Scenario &s, const std::string &v) {
+         s.dim = static_cast<int>(scenarioNumber(v));
+         if (s.dim != 2 && s.dim != 3) {
+           throw std::runtime_error("dim must be 2 or 3");
+         }
+       }},
+      {"precision",
+       [](Scenario &s, const std::string &v) {
+         if (v != "float" && v != "double") {
+           throw std::runtime_error("precision must be float or double");
+         }
+         s.doublePrecision = v == "double";
+       }},
+      {"count",
+       [](Scenario &s, const std::string &v) {
+         s.count = static_cast<size_t>(scenarioWhole(v, 4294967295.0));
+       }},
+      {"radius",
+       [](Scenario &s, const std::string &v) {
+         scenarioRange(v, s.radiusMin, s.radiusMax);
+       }},
+      {"mass",
+       [](Scenario &s, const std::string &v) {
+         scenarioRange(v, s.massMin, s.massMax);
+       }},
+      {"speedMin",
+       [](Scenario &s, const std::string &v) {
+         scenarioAxes(v, s.speedMin);
+       }},
+      {"speedMax",
+       [](Scenario &s, const std::string &v) {
+         scenarioAxes(v, s.speedMax);
+       }},
+      {"halfExtent",
+       [](Scenario &s, const std::string &v) {
+         scenarioAxes(v, s.halfExtent, true);
+       }},
+      {"spawnExtent",
+       [](Scenario &s, const std::string &v) {
+         scenarioAxes(v, s.spawnExtent);
+       }},
+      {"gravity",
+       [](Scenario &s, const std::string &v) {
+         scenarioAxes(v, s.gravity);
+       }},
+      {"wallRestitution",
+       [](Scenario &s, const std::string &v) {
+         s.wallRestitution = scenarioRestitution(v);
+       }},
+      {"ballRestitution",
+       [](Scenario &s, const std::string &v) {
+         s.ballRestitution = scenarioRestitution(v);
+       }},
+      {"steps",
+       [](Scenario &s, const std::string &v) {
+         s.steps = static_cast<int>(scenarioWhole(v, 2147483647.0));
+       }},
+      {"dt",
+       [](Scenario &s, const std::string &v) {
+         s.dt = scenarioNumber(v);
+         if (!(s.dt > 0)) {
+           throw std::runtime_error("expected a value above 0, got '" + v +
+                                    "'");
+         }
+       }},
+      {"threads",
+       [](Scenario &s, const std::string &v) {
+         s.threads = static_cast<unsigned>(scenarioWhole(v, 4096));
+       }},
+      {"seed",
+       [](Scenario &s, const std::string &v) {
+         s.seed = std::strtoull(v.c_str(), nullptr, 10);
+       }},
+  };
+  return table;
+}
+
+struct ScenarioEntry {
+  const ScenarioSetter *set;
+  std::string key;
+  std::vector<std::string> values;
+  std::string where; // path:line for errors
+};
+
+inline void expandScenario(const std::vector<ScenarioEntry> &entries,
+                           size_t next, Scenario current,
+                           std::vector<Scenario> &out) {
+  if (next == entries.size()) {
+    out.push_back(current);
+    return;
+  }
+  const ScenarioEntry &e = entries[next];
+  for (const std::string &value : e.values) {
+    Scenario s = current;
+    try {
+      (*e.set)(s, value);
+    } catch (const std::runtime_error &error) {
+      throw std::runtime_error(e.where + ": " + e.key + ": " + error.what());
+    }
+    if (e.values.size() > 1) {
+      s.label += (s.label.empty() ? "" : " ") + e.key + "=" + value;
+    }
+    expandScenario(entries, next + 1, s, out);
+  }
+}
+
+// every combination the file describes, in file order
+inline std::vector<Scenario> loadScenarios(const std::string &path,
+                                           const Scenario &defaults = {}) {
+  std::ifstream in(path);
+  if (!in) {
+    throw std::runtime_error("cannot open scenario " + path);
+  }
+  std::vector<ScenarioEntry> entries;
+  std::string line;
+  for (int lineNumber = 1; std::getline(in, line); ++lineNumber) {
+    line = scenarioTrim(line.substr(0, line.find('#')));
+    if (line.empty()) {
+      continue;
+    }
+    const std::string where = path + ":" + std::to_string(lineNumber);
+    const size_t eq = line.find('=');
+    if (eq == std::string::npos) {
+      throw std::runtime_error(where + ": expected 'key = value'");
+    }
+    ScenarioEntry e;
+    e.key = scenarioTrim(line.substr(0, eq));
+    e.where = where;
+    e.set = nullptr;
+    for (const auto &s : scenarioKeys()) {
+      if (s.first == e.key) {
+        e.set = &s.second;
+      }
+    }
+    if (!e.set) {
+      throw std::runtime_error(where + ": unknown key '" + e.key + "'");
+    }
+    std::istringstream values(line.substr(eq + 1));
+    std::string value;
+    while (std::getline(values, value, ',')) {
+      e.values.push_back(scenarioTrim(value));
+    }
+    if (e.values.empty()) {
+      throw std::runtime_error(where + ": missing value");
+    }
+    entries.push_back(e);
+  }
+  std::vector<Scenario> out;
+  expandScenario(entries, 0, defaults, out);
+  return out;
+}
+
+// a file describing exactly one scenario, for the apps
+inline Scenario loadScenario(const std::string &path,
+                             const Scenario &defaults = {}) {
+  std::vector<Scenario> all = loadScenarios(path, defaults);
+  if (all.size() != 1) {
+    throw std::runtime_error(path + " lists " + std::to_string(all.size()) +
+                             " scenarios, expected one");
+  }
+  return all[0];
+}
+
+template <int Dim, typename Real>
+SceneParams<Dim, Real> sceneOf(const Scenario &s) {
+  SceneParams<Dim, Real> scene;
+  for (int d = 0; d < Dim; ++d) {
+    scene.halfExtent[d] = static_cast<Real>(s.halfExtent[d]);
+    scene.gravity[d] = static_cast<Real>(s.gravity[d]);
+  }
+  scene.wallRestitution = static_cast<Real>(s.wallRestitution);
+  scene.ballRestitution = static_cast<Real>(s.ballRestitution);
+  return scene;
+}
+
+template <int Dim, typename Real>
+SpawnRanges<Dim, Real> rangesOf(const Scenario &s) {
+  SpawnRanges<Dim, Real> ranges;
+  for (int d = 0; d < Dim; ++d) {
+    double extent = s.spawnExtent[d] >= 0
+                        ? s.spawnExtent[d]
+                        : std::max(0.0, s.halfExtent[d] - s.radiusMax);
+    ranges.centerExtent[d] = static_cast<Real>(extent);
+    ranges.speedMin[d] = static_cast<Real>(s.speedMin[d]);
+    ranges.speedMax[d] = static_cast<Real>(s.speedMax[d]);
+  }
+  ranges.radiusMin = static_cast<Real>(s.radiusMin);
+  ranges.radiusMax = static_cast<Real>(s.radiusMax);
+  ranges.massMin = static_cast<Real>(s.massMin);
+  ranges.massMax = static_cast<Real>(s.massMax);
+  return ranges;
+}
@@ -0,0 +1,373 @@
+#pragma once
+#include "cellGrid.hpp"
+#include "jobSystem.hpp"
+#include "kernels.hpp"
+#include "particles.hpp"
+#include "spawn.hpp"
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+// Splits the container along x into slabs, each owned by a worker process.
+// Neighbouring workers share a connected Unix domain stream socket. Every step
+// they hand over the balls that left their slab (migration) and send copies
+// of the balls within one diameter of the shared face (halo), so contacts
+// across the face are seen from both sides. Nothing assumes the peer is on
+// the same machine, a TCP socket could stand in for the socket pair.
+
+// one end of a stream socket, blocks until all bytes have moved
+struct SlabLink {
+  int fd{-1};
+
+  void send(const void *data, size_t bytes) const {
+    const char *p = static_cast<const char *>(data);
+    while (bytes > 0) {
+      ssize_t n = ::write(fd, p, bytes);
+      if (n <= 0) {
+        throw std::runtime_error("slab link write failed");
+      }
+      p += n;
+      bytes -= static_cast<size_t>(n);
+    }
+  }
+
+  void recv(void *data, size_t bytes) const {
+    char *p = static_cast<char *>(data);
+    while (bytes > 0) {
+      ssize_t n = ::read(fd, p, bytes);
+      if (n <= 0) {
+        throw std::runtime_error("slab link read failed");
+      }
+      p += n;
+      bytes -= static_cast<size_t>(n);
+    }
+  }
+};
+
+// per step averages of one worker, sent back to the parent when it finishes
+struct SlabReport {
+  int rank{0};
+  uint64_t owned{0};
+  uint64_t migrated{0};
+  double halo{0.0};
+  double computeMs{0.0};
+  double commMs{0.0};
+};
+
+template <int Dim, typename Real> class SlabWorker {
+public:
+  ParticleState<Dim, Real> owned;
+
+  SlabWorker(int rank, int ranks, const SceneParams<Dim, Real> &scene,
+             Real haloWidth, SlabLink left, SlabLink right)
+      : rank(rank), ranks(ranks), scene(scene), haloWidth(haloWidth),
+        links{left, right} {
+    const Real width = 2 * scene.halfExtent[0] / ranks;
+    lo = -scene.halfExtent[0] + width * rank;
+    hi = rank == ranks - 1 ? scene.halfExtent[0] : lo + width;
+  }
+
+  bool inSlab(Real x) const {
+    return (rank == 0 || x >= lo) && (rank == ranks - 1 || x < hi);
+  }
+
+  void step(JobSystem &jobs, Real dt) {
+    auto t0 = std::chrono::steady_clock::now();
+    updatePhysics(jobs, owned, scene, dt);
+    auto t1 = std::chrono::steady_clock::now();
+
+    // migration, balls that left the slab move to the neighbour for good
+    clearOutbound();
+    keepIf([&](size_t i) {
+      if (inSlab(owned.pos[0][i])) {
+        return true;
+      }
+      outbound[owned.pos[0][i] < lo ? 0 : 1].push_back(record(i));
+      return false;
+    });
+    migrated += outbound[0].size() + outbound[1].size();
+    swapWithNeighbours();
+    for (int side = 0; side < 2; ++side) {
+      for (const Record &r : inbound[side]) {
+        append(r, 0);
+      }
+    }
+
+    // halo, read only copies of the balls near each shared face
+    clearOutbound();
+    for (size_t i = 0; i < owned.size(); ++i) {
+      const Real x = owned.pos[0][i];
+      if (rank > 0 && x < lo + haloWidth) {
+        outbound[0].push_back(record(i));
+      }
+      if (rank < ranks - 1 && x >= hi - haloWidth) {
+        outbound[1].push_back(record(i));
+      }
+    }
+    swapWithNeighbours();
+    for (int side = 0; side < 2; ++side) {
+      halo += inbound[side].size();
+      for (const Record &r : inbound[side]) {
+        append(r, ghostBit);
+      }
+    }
+    auto t2 = std::chrono::steady_clock::now();
+
+    // the grid only needs to cover the slab and its halo
+    Real boxLo[Dim], boxHi[Dim];
+    for (int d = 0; d < Dim; ++d) {
+      boxLo[d] = -scene.halfExtent[d];
+      boxHi[d] = scene.halfExtent[d];
+    }
+    boxLo[0] = rank == 0 ? boxLo[0] : lo - haloWidth;
+    boxHi[0] = rank == ranks - 1 ? boxHi[0] : hi + haloWidth;
+    grid.build(jobs, owned, boxLo, boxHi);
+    grid.ballCollisions(owned, scene);
+    keepIf([&](size_t i) { return (owned.id[i] & ghostBit) == 0; });
+    auto t3 = std::chrono::steady_clock::now();
+
+    computeNs += std::chrono::duration<double, std::nano>(t1 - t0 + t3 - t2)
+                     .count();
+    commNs += std::chrono::duration<double, std::nano>(t2 - t1).count();
+    ++steps;
+  }
+
+  SlabReport report() const {
+    SlabReport r;
+    r.rank = rank;
+    r.owned = owned.size();
+    r.migrated = migrated;
+    if (steps > 0) {
+      r.halo = static_cast<double>(halo) / steps;
+      r.computeMs = computeNs * 1e-6 / steps;
+      r.commMs = commNs * 1e-6 / steps;
+    }
+    return r;
+  }
+
+private:
+  // ghost copies carry this bit in their id until they are dropped
+  static constexpr uint32_t ghostBit = 0x80000000u;
+
+  struct Record {
+    Real pos[Dim];
+    Real vel[Dim];
+    Real radius;
+    Real mass;
+    uint32_t id;
+  };
+
+  int rank, ranks;
+  SceneParams<Dim, Real> scene;
+  Real haloWidth;
+  Real lo{0}, hi{0};
+  SlabLink links[2];
+  CellGrid<Dim, Real> grid;
+  std::vector<Record> outbound[2], inbound[2];
+
+  uint64_t steps{0}, migrated{0}, halo{0};
+  double computeNs{0.0}, commNs{0.0};
+
+  Record record(size_t i) const {
+    Record r;
+    for (int d = 0; d < Dim; ++d) {
+      r.pos[d] = owned.pos[d][i];
+      r.vel[d] = owned.vel[d][i];
+    }
+    r.radius = owned.radius[i];
+    r.mass = owned.mass[i];
+    r.id = owned.id[i];
+    return r;
+  }
+
+  void append(const Record &r, uint32_t flags) {
+    owned.add(r.pos, r.vel, r.radius, r.mass);
+    owned.id.back() = r.id | flags;
+  }
+
+  void clearOutbound() {
+    outbound[0].clear();
+    outbound[1].clear();
+  }
+
+  // stable in place compaction of every column
+  template <typename Pred> void keepIf(Pred keep) {
+    size_t out = 0;
+    for (size_t i = 0; i < owned.size(); ++i) {
+      if (!keep(i)) {
+        continue;
+      }
+      for (int d = 0; d < Dim; ++d) {
+        owned.pos[d][out] = owned.pos[d][i];
+        owned.vel[d][out] = owned.vel[d][i];
+      }
+      owned.radius[out] = owned.radius[i];
+      owned.mass[out] = owned.mass[i];
+      owned.id[out] = owned.id[i];
+      ++out;
+    }
+    for (int d = 0; d < Dim; ++d) {
+      owned.pos[d].resize(out);
+      owned.vel[d].resize(out);
+    }
+    owned.radius.resize(out);
+    owned.mass.resize(out);
+    owned.id.resize(out);
+  }
+
+  void exchange(int side, bool sendFirst) {
+    const SlabLink &link = links[side];
+    auto sendAll = [&] {
+      uint64_t n = outbound[side].size();
+      link.send(&n, sizeof(n));
+      link.send(outbound[side].data(), n * sizeof(Record));
+    };
+    auto recvAll = [&] {
+      uint64_t n = 0;
+      link.recv(&n, sizeof(n));
+      inbound[side].resize(n);
+      link.recv(inbound[side].data(), n * sizeof(Record));
+    };
+    if (sendFirst) {
+      sendAll();
+      recvAll();
+    } else {
+      recvAll();
+      sendAll();
+    }
+  }
+
+  // Face (k, k + 1) is exchanged in phase k % 2 with k sending first, so at
+  // most one face per worker is busy at a time and large messages can never
+  // leave both ends blocked in write.
+  void swapWithNeighbours() {
+    inbound[0].clear();
+    inbound[1].clear();
+    for (int phase = 0; phase < 2; ++phase) {
+      if (rank % 2 == phase && rank < ranks - 1) {
+        exchange(1, true);
+      }
+      if ((rank + 1) % 2 == phase && rank > 0) {
+        exchange(0, false);
+      }
+    }
+  }
+};
+
+// Forks one worker per slab and returns their reports in rank order. Every
+// worker spawns the same seeded set and keeps the balls inside its slab.
+// Call it before any JobSystem exists in this process, fork copies only the
+// calling thread.
+template <int Dim, typename Real>
+std::vector<SlabReport>
+runSlabs(int ranks, const SceneParams<Dim, Real> &scene,
+         const SpawnRanges<Dim, Real> &spawn, int count, int steps, Real dt,
+         unsigned threadsPerRank, uint64_t seed) {
+  std::vector<int> faces(2 * (ranks - 1));
+  std::vector<int> reports(2 * ranks);
+  for (int k = 0; k < ranks - 1; ++k) {
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, &faces[2 * k]) != 0) {
+      throw std::runtime_error("socketpair failed");
+    }
+  }
+  for (int r = 0; r < ranks; ++r) {
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, &reports[2 * r]) != 0) {
+      throw std::runtime_error("socketpair failed");
+    }
+  }
+
+  // children inherit stdio buffers, anything pending would print twice
+  std::cout.flush();
+  fflush(stdout);
+
+  std::vector<pid_t> children;
+  for (int r = 0; r < ranks; ++r) {
+    pid_t pid = fork();
+    if (pid < 0) {
+      throw std::runtime_error("fork failed");
+    }
+    if (pid > 0) {
+      children.push_back(pid);
+      continue;
+    }
+
+    // keep only this worker's ends, so a dead peer shows up as end of file
+    SlabLink left, right, parent{reports[2 * r + 1]};
+    if (r > 0) {
+      left.fd = faces[2 * (r - 1) + 1];
+    }
+    if (r < ranks - 1) {
+      right.fd = faces[2 * r];
+    }
+    for (int fd : faces) {
+      if (fd != left.fd && fd != right.fd) {
+        close(fd);
+      }
+    }
+    for (int fd : reports) {
+      if (fd != parent.fd) {
+        close(fd);
+      }
+    }
+
+    int status = 0;
+    try {
+      const Real haloWidth = 2 * spawn.radiusMax;
+      SlabWorker<Dim, Real> worker(r, ranks, scene, haloWidth, left, right);
+
+      JobSystem jobs(threadsPerRank);
+      ParticleState<Dim, Real> all;
+      spawnRandom(jobs, all, spawn, count, seed);
+      for (size_t i = 0; i < all.size(); ++i) {
+        if (worker.inSlab(all.pos[0][i])) {
+          Real p[Dim], v[Dim];
+          for (int d = 0; d < Dim; ++d) {
+            p[d] = all.pos[d][i];
+            v[d] = all.vel[d][i];
+          }
+          worker.owned.add(p, v, all.radius[i], all.mass[i]);
+          worker.owned.id.back() = all.id[i];
+        }
+      }
+
+      for (int step = 0; step < steps; ++step) {
+        worker.step(jobs, dt);
+      }
+      SlabReport report = worker.report();
+      parent.send(&report, sizeof(report));
+    } catch (const std::exception &e) {
+      std::cerr << "slab " << r << ": " << e.what() << std::endl;
+      status = 1;
+    }
+    _exit(status);
+  }
+
+  for (int fd : faces) {
+    close(fd);
+  }
+  for (int r = 0; r < ranks; ++r) {
+    close(reports[2 * r + 1]);
+  }
+  // a worker that failed leaves its report with rank -1
+  std::vector<SlabReport> out(ranks);
+  for (int r = 0; r < ranks; ++r) {
+    try {
+      SlabLink{reports[2 * r]}.recv(&out[r], sizeof(SlabReport));
+    } catch (const std::exception &) {
+      out[r].rank = -1;
+    }
+    close(reports[2 * r]);
+  }
+  for (pid_t pid : children) {
+    waitpid(pid, nullptr, 0);
+  }
+  return out;
+}
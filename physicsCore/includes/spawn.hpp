@@ -0,0 +1,72 @@
+#pragma once
+#include "jobSystem.hpp"
+#include "particles.hpp"
+#include "random.hpp"
+
+// Ranges for random ball placement
+template <int Dim, typename Real> struct SpawnRanges {
+  Real centerExtent[Dim]{}; // centers uniform in [-extent, extent]
+  Real speedMin[Dim]{};     // per axis speed, the sign is random
+  Real speedMax[Dim]{};
+  Real radiusMin{25};
+  Real radiusMax{25};
+  Real massMin{5};
+  Real massMax{100};
+};
+
+// Ball `index` draws from its own stream, so a ball is the same whether it
+// was spawned serially, in parallel or together with other balls.
+template <int Dim, typename Real>
+void spawnOne(const SpawnRanges<Dim, Real> &ranges, uint64_t seed,
+              uint64_t index, Real *p, Real *v, Real &r, Real &m) {
+  RandomStream rng(seed, index);
+  for (int d = 0; d < Dim; ++d) {
+    p[d] = rng.uniform(-ranges.centerExtent[d], ranges.centerExtent[d]);
+  }
+  for (int d = 0; d < Dim; ++d) {
+    Real speed = rng.uniform(ranges.speedMin[d], ranges.speedMax[d]);
+    v[d] = (rng.next() & 1) ? speed : -speed;
+  }
+  r = rng.uniform(ranges.radiusMin, ranges.radiusMax);
+  m = rng.uniform(ranges.massMin, ranges.massMax);
+}
+
+template <int Dim, typename Real>
+void spawnRandom(ParticleState<Dim, Real> &s,
+                 const SpawnRanges<Dim, Real> &ranges, size_t count,
+                 uint64_t seed) {
+  s.reserve(s.size() + count);
+  for (size_t i = 0; i < count; ++i) {
+    Real p[Dim], v[Dim], r, m;
+    spawnOne(ranges, seed, s.size(), p, v, r, m);
+    s.add(p, v, r, m);
+  }
+}
+
+// same balls as the serial version, written straight into the columns
+template <int Dim, typename Real>
+void spawnRandom(JobSystem &jobs, ParticleState<Dim, Real> &s,
+                 const SpawnRanges<Dim, Real> &ranges, size_t count,
+                 uint64_t seed) {
+  const size_t base = s.size();
+  for (int d = 0; d < Dim; ++d) {
+    s.pos[d].resize(base + count);
+    s.vel[d].resize(base + count);
+  }
+  s.radius.resize(base + count);
+  s.mass.resize(base + count);
+  s.id.resize(base + count);
+
+  jobs.parallelFor(base, base + count, 16384, [&](size_t b, size_t e,
+                                                 size_t) {
+    for (size_t i = b; i < e; ++i) {
+      Real p[Dim], v[Dim];
+      spawnOne(ranges, seed, i, p, v, s.radius[i], s.mass[i]);
+      for (int d = 0; d < Dim; ++d) {
+        s.pos[d][i] = p[d];
+        s.vel[d][i] = v[d];
+      }
+      s.id[i] = static_cast<uint32_t>(i);
+    }
+  });
+}
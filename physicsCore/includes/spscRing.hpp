@@ -0,0 +1,65 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Bounded single producer, single consumer queue. push() and pop() never
+// block or allocate; a full ring refuses the push and the producer decides
+// whether to drop or retry. Head and tail live on separate cache lines and
+// each side keeps a stale copy of the other's index, so the shared lines are
+// only read when the cached view says full or empty.
+template <typename T> class SpscRing {
+public:
+  // capacity is rounded up to a power of two
+  explicit SpscRing(size_t capacity) {
+    size_t n = 2;
+    while (n < capacity) {
+      n *= 2;
+    }
+    slots.resize(n);
+    mask = n - 1;
+  }
+
+  // producer only
+  bool push(const T &value) {
+    const size_t h = head.load(std::memory_order_relaxed);
+    if (h - tailSeen == slots.size()) {
+      tailSeen = tail.load(std::memory_order_acquire);
+      if (h - tailSeen == slots.size()) {
+        return false;
+      }
+    }
+    slots[h & mask] = value;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  // consumer only
+  bool pop(T &value) {
+    const size_t t = tail.load(std::memory_order_relaxed);
+    if (t == headSeen) {
+      headSeen = head.load(std::memory_order_acquire);
+      if (t == headSeen) {
+        return false;
+      }
+    }
+    value = slots[t & mask];
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  // either side, a snapshot that may already be stale
+  bool empty() const {
+    return head.load(std::memory_order_acquire) ==
+           tail.load(std::memory_order_acquire);
+  }
+  size_t capacity() const { return slots.size(); }
+
+private:
+  std::vector<T> slots;
+  size_t mask{0};
+  alignas(64) std::atomic<size_t> head{0};
+  size_t tailSeen{0}; // producer's copy of tail
+  alignas(64) std::atomic<size_t> tail{0};
+  size_t headSeen{0}; // consumer's copy of head
+};
@@ -0,0 +1,299 @@
+#pragma once
+#include "jobSystem.hpp"
+#include "particles.hpp"
+#include "spscRing.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// one row of the statistics stream
+struct StepStats {
+  uint64_t step{0};
+  double time{0.0};
+  double kineticEnergy{0.0};
+  double momentum[3]{};
+  double wallPressure{0.0}; // impulse per unit wall area and time
+  uint64_t wallHits{0};
+  uint64_t contacts{0}; // ball contacts, passed in by the caller
+};
+
+// Per step reductions over the particle columns. Each chunk sums into its
+// own cache line and the partials are folded in chunk order, so the result
+// does not depend on the thread count.
+//
+// Wall impulses are read off the state after the step: a ball resting on a
+// wall and moving away from it bounced this step, with an impulse of
+// m |v| (1 + 1 / e). Nothing is added to the physics kernels.
+template <int Dim, typename Real> class StatsStage {
+public:
+  StepStats measure(JobSystem &jobs, const ParticleState<Dim, Real> &s,
+                    const SceneParams<Dim, Real> &scene, Real dt,
+                    uint64_t step, double time, uint64_t contacts) {
+    const size_t chunks = JobSystem::chunkCount(s.size(), grain);
+    if (partials.size() < chunks) {
+      partials.resize(chunks);
+    }
+    const double e = scene.wallRestitution;
+    const double bounce = e > 0 ? 1.0 + 1.0 / e : 0.0;
+    // Column by column, so each pass streams three arrays. Short blocks sum
+    // in Real across independent lanes, which the compiler vectorises, and
+    // only the block totals are carried in double.
+    jobs.parallelFor(0, s.size(), grain, [&](size_t b, size_t en, size_t c) {
+      Partial p;
+      const Real *m = s.mass.data();
+      const Real *r = s.radius.data();
+      for (int d = 0; d < Dim; ++d) {
+        const Real *x = s.pos[d].data();
+        const Real *v = s.vel[d].data();
+        const Real h = scene.halfExtent[d];
+        for (size_t bb = b; bb < en; bb += block) {
+          const size_t be = std::min(bb + block, en);
+          Real momentum[lanes]{}, twiceKinetic[lanes]{}, impulse[lanes]{};
+          uint32_t hits[lanes]{};
+          auto add = [&](int l, size_t i) {
+            const Real mv = m[i] * v[i];
+            const Real wall = h - r[i] * static_cast<Real>(1.001);
+            const bool hit = ((x[i] >= wall) & (v[i] < 0)) |
+                             ((x[i] <= -wall) & (v[i] > 0));
+            momentum[l] += mv;
+            twiceKinetic[l] += mv * v[i];
+            impulse[l] += hit ? std::abs(mv) : Real(0);
+            hits[l] += hit;
+          };
+          size_t i = bb;
+          for (; i + lanes <= be; i += lanes) {
+            for (int l = 0; l < lanes; ++l) {
+              add(l, i + l);
+            }
+          }
+          for (; i < be; ++i) {
+            add(0, i);
+          }
+          for (int l = 0; l < lanes; ++l) {
+            p.momentum[d] += momentum[l];
+            p.kinetic += 0.5 * twiceKinetic[l];
+            p.impulse += impulse[l] * bounce;
+            p.hits += hits[l];
+          }
+        }
+      }
+      partials[c] = p;
+    });
+
+    StepStats out;
+    out.step = step;
+    out.time = time;
+    out.contacts = contacts;
+    double impulse = 0.0;
+    for (size_t c = 0; c < chunks; ++c) {
+      out.kineticEnergy += partials[c].kinetic;
+      for (int d = 0; d < Dim; ++d) {
+        out.momentum[d] += partials[c].momentum[d];
+      }
+      impulse += partials[c].impulse;
+      out.wallHits += partials[c].hits;
+    }
+    const double area = wallArea(scene);
+    out.wallPressure = area > 0 && dt > 0 ? impulse / (area * dt) : 0.0;
+    return out;
+  }
+
+private:
+  static constexpr size_t grain = 16384;
+  static constexpr size_t block = 256;
+  static constexpr int lanes = 8;
+
+  struct alignas(64) Partial {
+    double kinetic{0.0};
+    double momentum[3]{};
+    double impulse{0.0};
+    uint64_t hits{0};
+  };
+  std::vector<Partial> partials;
+
+  // faces in 3D, edges in 2D
+  static double wallArea(const SceneParams<Dim, Real> &scene) {
+    double total = 0.0;
+    for (int d = 0; d < Dim; ++d) {
+      double face = 2.0;
+      for (int k = 0; k < Dim; ++k) {
+        face *= k == d ? 1.0 : 2.0 * scene.halfExtent[k];
+      }
+      total += face;
+    }
+    return total;
+  }
+};
+
+enum class StatsFormat { Csv, Columnar };
+
+// Columnar stats file:
+//   "BBSTATS1" | uint32 columns | names, each zero terminated | block*
+// and a block is uint32 rows followed by each column as rows doubles. Counts
+// are stored as doubles too, exact up to 2^53.
+const char statsMagic[8] = {'B', 'B', 'S', 'T', 'A', 'T', 'S', '1'};
+
+// Appends StepStats rows from the simulation thread. push() puts the row in
+// a lock free ring and returns; a background thread formats and writes
+// them. A full ring drops the row rather than stalling the step.
+class StatsWriter {
+public:
+  StatsWriter(const std::string &path, StatsFormat format,
+              size_t capacity = 4096)
+      : format(format), ring(capacity) {
+    file = std::fopen(path.c_str(), format == StatsFormat::Csv ? "w" : "wb");
+    if (!file) {
+      throw std::runtime_error("cannot create stats file " + path);
+    }
+    writeHeader();
+    worker = std::thread([this] { run(); });
+  }
+
+  // .csv gets text, anything else the columnar format
+  static StatsFormat formatFor(const std::string &path) {
+    const bool csv =
+        path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+    return csv ? StatsFormat::Csv : StatsFormat::Columnar;
+  }
+
+  ~StatsWriter() {
+    {
+      std::lock_guard<std::mutex> lock(m);
+      stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+    std::fclose(file);
+  }
+
+  StatsWriter(const StatsWriter &) = delete;
+  StatsWriter &operator=(const StatsWriter &) = delete;
+
+  // simulation thread only
+  bool push(const StepStats &row) {
+    if (!ring.push(row)) {
+      droppedRows.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    ++pushedRows;
+    return true;
+  }
+
+  // simulation thread, waits until every pushed row has been formatted
+  void drain() {
+    while (writtenRows.load() != pushedRows) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+  uint64_t rows() const { return writtenRows.load(); }
+  uint64_t dropped() const { return droppedRows.load(); }
+
+private:
+  static constexpr int columns = 9;
+  static constexpr size_t blockRows = 1024;
+
+  StatsFormat format;
+  SpscRing<StepStats> ring;
+  std::FILE *file{nullptr};
+  std::vector<double> block[columns];
+  std::atomic<uint64_t> writtenRows{0}, droppedRows{0};
+  uint64_t pushedRows{0};
+
+  std::mutex m;
+  std::condition_variable wake;
+  bool stopping{false};
+  std::thread worker;
+
+  static const char *name(int c) {
+    static const char *names[columns] = {
+        "step",      "time",         "kineticEnergy", "momentumX", "momentumY",
+        "momentumZ", "wallPressure", "wallHits",      "contacts"};
+    return names[c];
+  }
+
+  void writeHeader() {
+    if (format == StatsFormat::Csv) {
+      for (int c = 0; c < columns; ++c) {
+        std::fprintf(file, c ? ",%s" : "%s", name(c));
+      }
+      std::fputc('\n', file);
+      return;
+    }
+    const uint32_t count = columns;
+    std::fwrite(statsMagic, 1, sizeof(statsMagic), file);
+    std::fwrite(&count, sizeof(count), 1, file);
+    for (int c = 0; c < columns; ++c) {
+      std::fwrite(name(c), 1, std::strlen(name(c)) + 1, file);
+    }
+  }
+
+  void run() {
+    StepStats row;
+    for (;;) {
+      bool any = false;
+      while (ring.pop(row)) {
+        append(row);
+        any = true;
+      }
+      if (any) {
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(m);
+      if (stopping && ring.empty()) {
+        break;
+      }
+      // rows are not urgent, the producer never signals
+      wake.wait_for(lock, std::chrono::milliseconds(5));
+    }
+    flushBlock();
+    std::fflush(file);
+  }
+
+  void append(const StepStats &r) {
+    if (format == StatsFormat::Csv) {
+      std::fprintf(file, "%llu,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g,%llu,%llu\n",
+                   static_cast<unsigned long long>(r.step), r.time,
+                   r.kineticEnergy, r.momentum[0], r.momentum[1],
+                   r.momentum[2], r.wallPressure,
+                   static_cast<unsigned long long>(r.wallHits),
+                   static_cast<unsigned long long>(r.contacts));
+    } else {
+      const double values[columns] = {
+          static_cast<double>(r.step), r.time,
+          r.kineticEnergy,             r.momentum[0],
+          r.momentum[1],               r.momentum[2],
+          r.wallPressure,              static_cast<double>(r.wallHits),
+          static_cast<double>(r.contacts)};
+      for (int c = 0; c < columns; ++c) {
+        block[c].push_back(values[c]);
+      }
+      if (block[0].size() == blockRows) {
+        flushBlock();
+      }
+    }
+    writtenRows.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void flushBlock() {
+    const uint32_t rows = static_cast<uint32_t>(block[0].size());
+    if (format != StatsFormat::Columnar || rows == 0) {
+      return;
+    }
+    std::fwrite(&rows, sizeof(rows), 1, file);
+    for (int c = 0; c < columns; ++c) {
+      std::fwrite(block[c].data(), sizeof(double), rows, file);
+      block[c].clear();
+    }
+  }
+};
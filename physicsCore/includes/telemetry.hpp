@@ -0,0 +1,320 @@
+#pragma once
+#include "jobSystem.hpp"
+#include "particles.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+// Live telemetry in POSIX shared memory. The simulator publishes each step
+// into the next of a few slots, each guarded by a sequence lock: the count
+// is odd while the slot is being written. Readers map the region read only,
+// copy the newest slot out and check the count before and after the copy, so
+// the simulator never waits on them and a reader that falls behind gets a
+// torn copy it drops, never a stall. The copy is one pass over the columns
+// per frame; in exchange a slot rewritten mid draw never reaches the screen,
+// the reader keeps drawing its last good copy instead.
+//
+// Region: TelemetryHeader, then `slots` slots of slotBytes, each a
+// TelemetrySlot followed by pos[0..dim), radius (float) and color (RGBA8)
+// columns of `capacity` entries, every column 64 byte aligned.
+
+struct TelemetryHeader {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t dim;
+  uint64_t capacity;
+  uint64_t slots;
+  uint64_t slotBytes;
+  uint64_t columnBytes;
+  std::atomic<uint64_t> latest; // frame number of the newest complete slot
+  uint8_t reserved[8];
+};
+static_assert(sizeof(TelemetryHeader) == 64, "header layout changed");
+
+struct TelemetrySlot {
+  std::atomic<uint64_t> sequence;
+  uint64_t frame;
+  uint64_t step;
+  uint64_t count;
+  double time;
+  double stepMs;
+  double kineticEnergy;
+  uint64_t contacts;
+};
+static_assert(sizeof(TelemetrySlot) == 64, "slot layout changed");
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "shared counters must be address free");
+
+const uint64_t telemetryMagic = 0x314d4c5442424242ull; // "BBBTLM1"
+const uint32_t telemetryVersion = 1;
+
+// what a step reports next to the balls
+struct TelemetryFrameStats {
+  uint64_t step{0};
+  double time{0.0};
+  double stepMs{0.0};
+  double kineticEnergy{0.0};
+  uint64_t contacts{0};
+};
+
+inline uint32_t packColor(float r, float g, float b) {
+  auto byte = [](float c) {
+    return static_cast<uint32_t>(std::min(std::max(c, 0.0f), 1.0f) * 255.0f +
+                                 0.5f);
+  };
+  return byte(r) | byte(g) << 8 | byte(b) << 16 | 0xFF000000u;
+}
+
+inline uint64_t telemetryColumnBytes(uint64_t capacity) {
+  return (capacity * sizeof(float) + 63) / 64 * 64;
+}
+
+// Simulation side. Owns the region and removes its name when destroyed.
+template <int Dim, typename Real> class TelemetryPublisher {
+public:
+  static constexpr uint64_t slotCount = 4;
+
+  TelemetryPublisher(const std::string &name, size_t capacity)
+      : name(name) {
+    const uint64_t column = telemetryColumnBytes(capacity);
+    const uint64_t slotBytes = sizeof(TelemetrySlot) + (Dim + 2) * column;
+    bytes = sizeof(TelemetryHeader) + slotCount * slotBytes;
+
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0600);
+    if (fd < 0) {
+      throw std::runtime_error("cannot create shared memory " + name);
+    }
+    if (ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+      ::close(fd);
+      shm_unlink(name.c_str());
+      throw std::runtime_error("cannot size shared memory " + name);
+    }
+    base = static_cast<uint8_t *>(
+        mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+    ::close(fd);
+    if (base == MAP_FAILED) {
+      shm_unlink(name.c_str());
+      throw std::runtime_error("cannot map shared memory " + name);
+    }
+
+    // magic last, so a reader never sees a half initialised header
+    TelemetryHeader *h = header();
+    h->version = telemetryVersion;
+    h->dim = Dim;
+    h->capacity = capacity;
+    h->slots = slotCount;
+    h->slotBytes = slotBytes;
+    h->columnBytes = column;
+    h->latest.store(0, std::memory_order_relaxed);
+    for (uint64_t k = 0; k < slotCount; ++k) {
+      slot(k)->sequence.store(0, std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    h->magic = telemetryMagic;
+  }
+
+  ~TelemetryPublisher() {
+    munmap(base, bytes);
+    shm_unlink(name.c_str());
+  }
+
+  TelemetryPublisher(const TelemetryPublisher &) = delete;
+  TelemetryPublisher &operator=(const TelemetryPublisher &) = delete;
+
+  size_t capacity() const { return header()->capacity; }
+
+  // Copies positions, radii and per id colors into the next slot. Balls past
+  // capacity are left out. Never blocks.
+  void publish(JobSystem &jobs, const ParticleState<Dim, Real> &s,
+               const uint32_t *colorById, const TelemetryFrameStats &stats) {
+    const uint64_t frame = ++published;
+    TelemetrySlot *out = slot(frame % slotCount);
+    const size_t n = std::min(s.size(), capacity());
+
+    const uint64_t sequence = out->sequence.load(std::memory_order_relaxed);
+    out->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    out->frame = frame;
+    out->step = stats.step;
+    out->count = n;
+    out->time = stats.time;
+    out->stepMs = stats.stepMs;
+    out->kineticEnergy = stats.kineticEnergy;
+    out->contacts = stats.contacts;
+    float *pos[Dim];
+    for (int d = 0; d < Dim; ++d) {
+      pos[d] = column<float>(out, d);
+    }
+    float *radius = column<float>(out, Dim);
+    uint32_t *color = column<uint32_t>(out, Dim + 1);
+    jobs.parallelFor(0, n, 16384, [&](size_t b, size_t e, size_t) {
+      for (int d = 0; d < Dim; ++d) {
+        for (size_t i = b; i < e; ++i) {
+          pos[d][i] = static_cast<float>(s.pos[d][i]);
+        }
+      }
+      for (size_t i = b; i < e; ++i) {
+        radius[i] = static_cast<float>(s.radius[i]);
+        color[i] = colorById[s.id[i]];
+      }
+    });
+
+    out->sequence.store(sequence + 2, std::memory_order_release);
+    header()->latest.store(frame, std::memory_order_release);
+  }
+
+private:
+  std::string name;
+  uint8_t *base{nullptr};
+  size_t bytes{0};
+  uint64_t published{0};
+
+  TelemetryHeader *header() const {
+    return reinterpret_cast<TelemetryHeader *>(base);
+  }
+  TelemetrySlot *slot(uint64_t k) const {
+    return reinterpret_cast<TelemetrySlot *>(
+        base + sizeof(TelemetryHeader) + k * header()->slotBytes);
+  }
+  template <typename T> T *column(TelemetrySlot *s, int k) const {
+    return reinterpret_cast<T *>(reinterpret_cast<uint8_t *>(s) +
+                                 sizeof(TelemetrySlot) +
+                                 k * header()->columnBytes);
+  }
+};
+
+// Reader side, maps the region read only. The columns of a frame point
+// straight into shared memory; copy them out, then check valid() before
+// using the copy.
+class TelemetryView {
+public:
+  struct Frame {
+    const TelemetrySlot *slot{nullptr};
+    uint64_t sequence{0};
+    uint64_t frame{0};
+    uint64_t step{0};
+    size_t count{0};
+    double time{0.0};
+    double stepMs{0.0};
+    double kineticEnergy{0.0};
+    uint64_t contacts{0};
+    const float *pos[3]{};
+    const float *radius{nullptr};
+    const uint32_t *color{nullptr};
+  };
+
+  explicit TelemetryView(const std::string &name) {
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+      throw std::runtime_error("no telemetry published as " + name);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 ||
+        static_cast<size_t>(st.st_size) < sizeof(TelemetryHeader)) {
+      ::close(fd);
+      throw std::runtime_error("telemetry region too short: " + name);
+    }
+    bytes = static_cast<size_t>(st.st_size);
+    base = static_cast<const uint8_t *>(
+        mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0));
+    ::close(fd);
+    if (base == MAP_FAILED) {
+      throw std::runtime_error("cannot map telemetry " + name);
+    }
+    const char *problem = nullptr;
+    if (header()->magic != telemetryMagic ||
+        header()->version != telemetryVersion) {
+      problem = "not a telemetry region: ";
+    } else if (!layoutInside()) {
+      problem = "telemetry slots outside the region: ";
+    }
+    if (problem) {
+      munmap(const_cast<uint8_t *>(base), bytes);
+      throw std::runtime_error(problem + name);
+    }
+  }
+
+  ~TelemetryView() { munmap(const_cast<uint8_t *>(base), bytes); }
+
+  TelemetryView(const TelemetryView &) = delete;
+  TelemetryView &operator=(const TelemetryView &) = delete;
+
+  int dim() const { return static_cast<int>(header()->dim); }
+  size_t capacity() const { return header()->capacity; }
+
+  // the newest complete frame, false while nothing was published yet or
+  // the slot is being rewritten right now
+  bool acquire(Frame &f) const {
+    const uint64_t latest = header()->latest.load(std::memory_order_acquire);
+    if (latest == 0) {
+      return false;
+    }
+    const TelemetrySlot *s = slot(latest % header()->slots);
+    f.slot = s;
+    f.sequence = s->sequence.load(std::memory_order_acquire);
+    if (f.sequence & 1) {
+      return false;
+    }
+    f.frame = s->frame;
+    f.step = s->step;
+    f.count = std::min<uint64_t>(s->count, capacity());
+    f.time = s->time;
+    f.stepMs = s->stepMs;
+    f.kineticEnergy = s->kineticEnergy;
+    f.contacts = s->contacts;
+    for (int d = 0; d < dim(); ++d) {
+      f.pos[d] = column<float>(s, d);
+    }
+    f.radius = column<float>(s, dim());
+    f.color = column<uint32_t>(s, dim() + 1);
+    return valid(f);
+  }
+
+  // false when the publisher started rewriting the slot while it was read
+  bool valid(const Frame &f) const {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return f.slot->sequence.load(std::memory_order_relaxed) == f.sequence;
+  }
+
+private:
+  const uint8_t *base{nullptr};
+  size_t bytes{0};
+
+  const TelemetryHeader *header() const {
+    return reinterpret_cast<const TelemetryHeader *>(base);
+  }
+
+  // every slot and column the header describes lies inside the mapping
+  bool layoutInside() const {
+    const TelemetryHeader &h = *header();
+    const uint64_t room = bytes - sizeof(TelemetryHeader);
+    if (room < sizeof(TelemetrySlot) || (h.dim != 2 && h.dim != 3) ||
+        h.slots == 0 || h.columnBytes % 64 != 0 || h.slotBytes % 64 != 0 ||
+        h.capacity > h.columnBytes / sizeof(float)) {
+      return false;
+    }
+    const uint64_t columns = h.dim + 2;
+    return h.columnBytes <= (room - sizeof(TelemetrySlot)) / columns &&
+           h.slotBytes >= sizeof(TelemetrySlot) + columns * h.columnBytes &&
+           h.slots <= room / h.slotBytes;
+  }
+
+  const TelemetrySlot *slot(uint64_t k) const {
+    return reinterpret_cast<const TelemetrySlot *>(
+        base + sizeof(TelemetryHeader) + k * header()->slotBytes);
+  }
+  template <typename T> const T *column(const TelemetrySlot *s, int k) const {
+    return reinterpret_cast<const T *>(reinterpret_cast<const uint8_t *>(s) +
+                                       sizeof(TelemetrySlot) +
+                                       k * header()->columnBytes);
+  }
+};
@@ -0,0 +1,191 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Scoped timing zones for the frame and step loops, written out as Chrome
+// trace event JSON for chrome://tracing or ui.perfetto.dev. A thread gets
+// its own ring the first time it opens a zone and records into it without
+// a lock; a full ring overwrites its oldest zones. Write the trace once the
+// recording threads are done.
+//
+// TRACE_ZONE("name") times the rest of the enclosing scope, the name must
+// be a string literal. Zones are compiled in unless NDEBUG is defined,
+// -DTRACE_ZONES=1 or 0 overrides that.
+#ifndef TRACE_ZONES
+#ifdef NDEBUG
+#define TRACE_ZONES 0
+#else
+#define TRACE_ZONES 1
+#endif
+#endif
+
+class Trace {
+public:
+  // zones a thread keeps before overwriting, a power of two
+  static constexpr size_t laneCapacity = size_t(1) << 16;
+
+  struct Zone {
+    const char *name;
+    int64_t begin, end; // ticks, see now()
+  };
+
+  // written by its own thread only
+  struct Lane {
+    explicit Lane(uint32_t tid) : zones(laneCapacity), tid(tid) {}
+    std::vector<Zone> zones;
+    std::atomic<uint64_t> count{0};
+    uint32_t tid;
+    std::string name;
+
+    void push(const char *zone, int64_t begin, int64_t end) {
+      const uint64_t n = count.load(std::memory_order_relaxed);
+      zones[n & (laneCapacity - 1)] = Zone{zone, begin, end};
+      count.store(n + 1, std::memory_order_release);
+    }
+  };
+
+  static Trace &instance() {
+    static Trace trace;
+    return trace;
+  }
+
+  // the calling thread's lane
+  static Lane &lane() {
+    thread_local Lane *mine = nullptr;
+    if (!mine) {
+      mine = instance().add();
+    }
+    return *mine;
+  }
+
+  // labels the calling thread in the trace
+  static void nameThread(const std::string &name) {
+    Lane &l = lane();
+    std::lock_guard<std::mutex> lock(instance().m);
+    l.name = name;
+  }
+
+  // the time stamp counter where there is one, a steady clock read costs
+  // about as much as the whole zone should; write() converts to time
+  static int64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+    return static_cast<int64_t>(__rdtsc());
+#else
+    return steadyNs();
+#endif
+  }
+
+  // zones still held over every thread
+  uint64_t zones() {
+    std::lock_guard<std::mutex> lock(m);
+    uint64_t total = 0;
+    for (const auto &l : lanes) {
+      total += std::min<uint64_t>(l->count.load(), laneCapacity);
+    }
+    return total;
+  }
+
+  // one complete event per zone, times in microseconds from the first zone
+  void write(const std::string &path) {
+    std::FILE *file = std::fopen(path.c_str(), "w");
+    if (!file) {
+      throw std::runtime_error("cannot create trace " + path);
+    }
+    const double usPerTick = 1e-3 * (steadyNs() - startNs) /
+                             std::max<int64_t>(now() - startTicks, 1);
+    std::lock_guard<std::mutex> lock(m);
+    int64_t origin = INT64_MAX;
+    for (const auto &l : lanes) {
+      forEach(*l, [&](const Zone &z) { origin = std::min(origin, z.begin); });
+    }
+    std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    const char *separator = "";
+    for (const auto &l : lanes) {
+      std::string name = l->name.empty() ? "thread " + std::to_string(l->tid)
+                                         : l->name;
+      std::fprintf(file,
+                   "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                   "\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                   separator, l->tid, name.c_str());
+      separator = ",\n";
+      forEach(*l, [&](const Zone &z) {
+        std::fprintf(file,
+                     ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                     "\"ts\":%.3f,\"dur\":%.3f}",
+                     z.name, l->tid, (z.begin - origin) * usPerTick,
+                     (z.end - z.begin) * usPerTick);
+      });
+    }
+    std::fprintf(file, "\n]}\n");
+    std::fclose(file);
+  }
+
+private:
+  std::mutex m;
+  std::vector<std::unique_ptr<Lane>> lanes;
+  int64_t startTicks{now()};
+  int64_t startNs{steadyNs()};
+
+  static int64_t steadyNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  Lane *add() {
+    std::lock_guard<std::mutex> lock(m);
+    lanes.push_back(
+        std::make_unique<Lane>(static_cast<uint32_t>(lanes.size() + 1)));
+    return lanes.back().get();
+  }
+
+  template <typename Fn> static void forEach(const Lane &l, const Fn &fn) {
+    const uint64_t n = l.count.load(std::memory_order_acquire);
+    for (uint64_t k = n > laneCapacity ? n - laneCapacity : 0; k < n; ++k) {
+      fn(l.zones[k & (laneCapacity - 1)]);
+    }
+  }
+};
+
+class TraceZone {
+public:
+  explicit TraceZone(const char *name)
+      : lane(Trace::lane()), name(name), begin(Trace::now()) {}
+  ~TraceZone() { lane.push(name, begin, Trace::now()); }
+
+  TraceZone(const TraceZone &) = delete;
+  TraceZone &operator=(const TraceZone &) = delete;
+
+private:
+  Trace::Lane &lane;
+  const char *name;
+  int64_t begin;
+};
+
+#define TRACE_JOIN2(a, b) a##b
+#define TRACE_JOIN(a, b) TRACE_JOIN2(a, b)
+#if TRACE_ZONES
+#define TRACE_ZONE(name) TraceZone TRACE_JOIN(traceZone, __LINE__)(name)
+#else
+#define TRACE_ZONE(name) static_cast<void>(0)
+#endif
+
+// An app asked for --trace: without zones the run would end in an empty
+// trace, so refuse it up front.
+inline void requireTraceZones(const char *tracePath) {
+  if (tracePath && !TRACE_ZONES) {
+    throw std::runtime_error("--trace: zones are compiled out of this build "
+                             "(NDEBUG), rebuild with -DTRACE_ZONES=1");
+  }
+}
@@ -0,0 +1,685 @@
+#pragma once
+#include "jobSystem.hpp"
+#include "particles.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Trajectory file, version 1.
+//   header | frame* | frame index | footer
+// A frame is a FrameHeader and a payload holding one stream per column (pos
+// then vel, per axis, keyframes add radius), one value per id up to the
+// highest, preceded by the end offset of every stream so columns decode in
+// parallel.
+// Values are quantised to posBits/velBits over the container and
+// [-maxSpeed, maxSpeed], radius like a position. Keyframes store the values,
+// other frames the difference to the previous frame. Both are zigzag mapped
+// and Rice coded in blocks of 64 with a per block parameter. The index and
+// footer are written on close; a file without them (a crashed run) is still
+// readable by walking the frame headers.
+
+struct TrajectoryHeader {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t dim;
+  uint32_t posBits;
+  uint32_t velBits;
+  uint32_t keyframeInterval;
+  uint32_t reserved;
+  double halfExtent[3];
+  double maxSpeed;
+};
+static_assert(sizeof(TrajectoryHeader) == 64, "header layout changed");
+
+struct TrajectoryFrameHeader {
+  uint64_t step;
+  uint32_t count;
+  uint32_t keyframe;
+  uint64_t payloadBytes; // padded to 8
+};
+
+struct TrajectoryFooter {
+  uint64_t indexOffset;
+  uint64_t frameCount;
+  uint64_t magic;
+};
+
+const uint64_t trajectoryMagic = 0x314a525442424242ull; // "BBBBTRJ1"
+const uint32_t trajectoryVersion = 1;
+
+// a delta of two quantised values must still fit an int32 once zigzagged
+const uint32_t trajectoryMaxBits = 31;
+inline bool validTrajectoryBits(uint32_t bits) {
+  return bits >= 1 && bits <= trajectoryMaxBits;
+}
+
+struct TrajectoryConfig {
+  uint32_t posBits{16}; // container / 65535 per step
+  uint32_t velBits{12};
+  double maxSpeed{500.0};
+  uint32_t keyframeInterval{60};
+  size_t queueSlots{4}; // frames the sim may run ahead of the encoder
+};
+
+// Rice coding over 64 bit buffered words
+class RiceWriter {
+public:
+  explicit RiceWriter(std::vector<uint8_t> &out) : out(out) {}
+
+  void put(uint32_t bits, uint32_t value) {
+    if (bits == 0) {
+      return;
+    }
+    acc |= static_cast<uint64_t>(value & lowMask(bits)) << used;
+    used += bits;
+    while (used >= 8) {
+      out.push_back(static_cast<uint8_t>(acc));
+      acc >>= 8;
+      used -= 8;
+    }
+  }
+
+  // zigzagged values, k picked from the block mean
+  void block(const uint32_t *v, size_t n) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; ++i) {
+      sum += v[i];
+    }
+    uint32_t k = 0;
+    while (k < 31 && (static_cast<uint64_t>(n) << (k + 1)) <= sum) {
+      ++k;
+    }
+    put(5, k);
+    for (size_t i = 0; i < n; ++i) {
+      uint32_t q = v[i] >> k;
+      if (q < escape) {
+        put(q + 1, lowMask(q)); // q ones and a zero
+        put(k, v[i]);
+      } else {
+        put(escape, lowMask(escape));
+        put(16, v[i]);
+        put(16, v[i] >> 16);
+      }
+    }
+  }
+
+  void flush() {
+    while (used > 0) {
+      out.push_back(static_cast<uint8_t>(acc));
+      acc >>= 8;
+      used = used > 8 ? used - 8 : 0;
+    }
+    acc = 0;
+    while (out.size() % 8 != 0) {
+      out.push_back(0);
+    }
+  }
+
+  static constexpr uint32_t escape = 24;
+
+private:
+  std::vector<uint8_t> &out;
+  uint64_t acc{0};
+  uint32_t used{0};
+
+  static uint32_t lowMask(uint32_t bits) {
+    return bits >= 32 ? 0xFFFFFFFFu : (1u << bits) - 1;
+  }
+};
+
+class RiceReader {
+public:
+  RiceReader(const uint8_t *data, size_t bytes) : p(data), end(data + bytes) {}
+
+  uint32_t get(uint32_t bits) {
+    if (bits == 0) {
+      return 0;
+    }
+    refill();
+    uint32_t v = static_cast<uint32_t>(acc & ((uint64_t(1) << bits) - 1));
+    acc >>= bits;
+    used -= bits;
+    return v;
+  }
+
+  void block(uint32_t *v, size_t n) {
+    const uint32_t k = get(5);
+    const uint64_t lowBits = (uint64_t(1) << k) - 1;
+    for (size_t i = 0; i < n; ++i) {
+      // 57 bits cover the longest unary run plus its remainder
+      refill();
+      uint32_t q = static_cast<uint32_t>(__builtin_ctzll(~acc));
+      if (q < RiceWriter::escape) {
+        acc >>= q + 1;
+        v[i] = q << k | static_cast<uint32_t>(acc & lowBits);
+        acc >>= k;
+        used -= q + 1 + k;
+      } else {
+        acc >>= RiceWriter::escape;
+        used -= RiceWriter::escape;
+        uint32_t low = get(16);
+        v[i] = low | get(16) << 16;
+      }
+    }
+  }
+
+private:
+  const uint8_t *p, *end;
+  uint64_t acc{0};
+  uint32_t used{0};
+
+  void refill() {
+    if (used > 56) {
+      return;
+    }
+    if (end - p >= 8) {
+      // bits past `used` are the same bytes the next refill ORs in again
+      uint64_t word;
+      std::memcpy(&word, p, 8);
+      acc |= word << used;
+      p += (63 - used) >> 3;
+      used |= 56;
+      return;
+    }
+    while (used <= 56) {
+      uint64_t byte = p < end ? *p++ : 0;
+      acc |= byte << used;
+      used += 8;
+    }
+  }
+};
+
+inline uint32_t zigzag(int32_t v) {
+  return (static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31);
+}
+inline int32_t unzigzag(uint32_t v) {
+  return static_cast<int32_t>(v >> 1) ^ -static_cast<int32_t>(v & 1);
+}
+
+// one column of a frame, delta against prev unless it is null
+inline void encodeTrajectoryColumn(const std::vector<uint32_t> &cur,
+                                   const std::vector<uint32_t> *prev,
+                                   std::vector<uint8_t> &out) {
+  RiceWriter writer(out);
+  uint32_t block[64];
+  const size_t count = cur.size();
+  for (size_t b = 0; b < count; b += 64) {
+    const size_t n = std::min<size_t>(64, count - b);
+    for (size_t i = 0; i < n; ++i) {
+      int32_t base = prev ? static_cast<int32_t>((*prev)[b + i]) : 0;
+      block[i] = zigzag(static_cast<int32_t>(cur[b + i]) - base);
+    }
+    writer.block(block, n);
+  }
+  writer.flush();
+}
+
+// inverse of encodeTrajectoryColumn, cur holds the previous frame's column
+// on entry unless keyframe is set
+inline void decodeTrajectoryColumn(const uint8_t *data, size_t bytes,
+                                   bool keyframe, std::vector<uint32_t> &cur,
+                                   size_t count) {
+  RiceReader reader(data, bytes);
+  uint32_t block[64];
+  cur.resize(count);
+  for (size_t b = 0; b < count; b += 64) {
+    const size_t n = std::min<size_t>(64, count - b);
+    reader.block(block, n);
+    for (size_t i = 0; i < n; ++i) {
+      int32_t base = keyframe ? 0 : static_cast<int32_t>(cur[b + i]);
+      cur[b + i] = static_cast<uint32_t>(base + unzigzag(block[i]));
+    }
+  }
+}
+
+// Streams frames to disk from a background thread. record() copies the
+// state into a free queue slot and returns; when the encoder has fallen
+// queueSlots frames behind the frame is dropped instead, so the simulation
+// never waits on encoding or I/O.
+template <int Dim, typename Real> class TrajectoryRecorder {
+public:
+  static constexpr int columns = 2 * Dim; // radius is only in keyframes
+
+  TrajectoryRecorder(const std::string &path,
+                     const SceneParams<Dim, Real> &scene,
+                     const TrajectoryConfig &config = TrajectoryConfig())
+      : config(config), slots(std::max<size_t>(config.queueSlots, 2)) {
+    if (!validTrajectoryBits(config.posBits) ||
+        !validTrajectoryBits(config.velBits)) {
+      throw std::runtime_error("trajectory posBits and velBits must be 1 to " +
+                               std::to_string(trajectoryMaxBits));
+    }
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+      throw std::runtime_error("cannot create trajectory " + path);
+    }
+    TrajectoryHeader h;
+    std::memset(&h, 0, sizeof(h));
+    h.magic = trajectoryMagic;
+    h.version = trajectoryVersion;
+    h.dim = Dim;
+    h.posBits = config.posBits;
+    h.velBits = config.velBits;
+    h.keyframeInterval = std::max<uint32_t>(config.keyframeInterval, 1);
+    for (int d = 0; d < Dim; ++d) {
+      h.halfExtent[d] = scene.halfExtent[d];
+      posScale[d] = ((1u << config.posBits) - 1) / (2.0 * h.halfExtent[d]);
+      halfExtent[d] = h.halfExtent[d];
+    }
+    h.maxSpeed = config.maxSpeed;
+    velScale = ((1u << config.velBits) - 1) / (2.0 * config.maxSpeed);
+    header = h;
+    std::fwrite(&h, sizeof(h), 1, file);
+    offset = sizeof(h);
+    worker = std::thread([this] { run(); });
+  }
+
+  ~TrajectoryRecorder() {
+    stopping = true;
+    wake.notify_one();
+    worker.join();
+
+    TrajectoryFooter footer{offset, index.size(), trajectoryMagic};
+    std::fwrite(index.data(), sizeof(uint64_t), index.size(), file);
+    std::fwrite(&footer, sizeof(footer), 1, file);
+    std::fclose(file);
+  }
+
+  TrajectoryRecorder(const TrajectoryRecorder &) = delete;
+  TrajectoryRecorder &operator=(const TrajectoryRecorder &) = delete;
+
+  // sim thread only, false when the frame had to be dropped
+  bool record(const ParticleState<Dim, Real> &s, uint64_t step) {
+    const size_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) == slots.size()) {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    Slot &slot = slots[h % slots.size()];
+    for (int d = 0; d < Dim; ++d) {
+      slot.values[d].assign(s.pos[d].begin(), s.pos[d].end());
+      slot.values[Dim + d].assign(s.vel[d].begin(), s.vel[d].end());
+    }
+    slot.values[columns].assign(s.radius.begin(), s.radius.end());
+    slot.id.assign(s.id.begin(), s.id.end());
+    slot.step = step;
+    head.store(h + 1, std::memory_order_release);
+    wake.notify_one();
+    return true;
+  }
+
+  // waits for the encoder to catch up with every recorded frame
+  void drain() {
+    while (tail.load(std::memory_order_acquire) !=
+           head.load(std::memory_order_relaxed)) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+  uint64_t framesWritten() const { return written.load(); }
+  uint64_t framesDropped() const { return dropped.load(); }
+  uint64_t bytesWritten() const { return payloadBytes.load(); }
+
+  double bytesPerBallFrame() const {
+    uint64_t balls = ballFrames.load();
+    return balls ? static_cast<double>(payloadBytes.load()) / balls : 0.0;
+  }
+
+  void report(std::ostream &out) const {
+    double raw = columns * sizeof(Real);
+    out << "trajectory: " << framesWritten() << " frames, "
+        << framesDropped() << " dropped, " << bytesPerBallFrame()
+        << " bytes/ball/frame (raw " << raw << "), position step "
+        << 2.0 * halfExtent[0] / ((1u << config.posBits) - 1) << std::endl;
+  }
+
+private:
+  struct Slot {
+    std::vector<Real> values[columns + 1];
+    std::vector<uint32_t> id;
+    uint64_t step{0};
+  };
+
+  TrajectoryConfig config;
+  TrajectoryHeader header;
+  std::FILE *file{nullptr};
+  double posScale[Dim]{}, halfExtent[Dim]{};
+  double velScale{0.0};
+
+  std::vector<Slot> slots;
+  std::atomic<size_t> head{0}, tail{0};
+  std::atomic<bool> stopping{false};
+  std::mutex m;
+  std::condition_variable wake;
+  std::thread worker;
+
+  // encoder thread only
+  std::vector<uint32_t> cur[columns + 1], prev[columns];
+  std::vector<uint8_t> payload;
+  std::vector<uint64_t> index;
+  uint64_t offset{0};
+  uint64_t frame{0};
+  // 1 per id a ball holds, a change forces a keyframe
+  std::vector<uint8_t> occupied, lastOccupied;
+
+  std::atomic<uint64_t> written{0}, dropped{0}, payloadBytes{0},
+      ballFrames{0};
+
+  static uint32_t quantise(double x, double scale, uint32_t bits) {
+    double q = std::floor(x * scale + 0.5);
+    double top = static_cast<double>((1u << bits) - 1);
+    return static_cast<uint32_t>(std::min(std::max(q, 0.0), top));
+  }
+
+  void run() {
+    for (;;) {
+      const size_t t = tail.load(std::memory_order_relaxed);
+      if (t == head.load(std::memory_order_acquire)) {
+        if (stopping && t == head.load(std::memory_order_acquire)) {
+          return;
+        }
+        // the timeout covers a notify that lands before the wait
+        std::unique_lock<std::mutex> lock(m);
+        wake.wait_for(lock, std::chrono::milliseconds(2));
+        continue;
+      }
+      encode(slots[t % slots.size()]);
+      tail.store(t + 1, std::memory_order_release);
+    }
+  }
+
+  // A frame holds one value per id up to the highest, ids no ball has
+  // (a pool with free slots) read back with radius 0.
+  void encode(const Slot &slot) {
+    size_t n = 0;
+    for (uint32_t id : slot.id) {
+      n = std::max<size_t>(n, size_t(id) + 1);
+    }
+    for (int c = 0; c <= columns; ++c) {
+      cur[c].assign(n, 0);
+    }
+    occupied.assign(n, 0);
+    for (size_t i = 0; i < slot.id.size(); ++i) {
+      const uint32_t id = slot.id[i];
+      occupied[id] = 1;
+      for (int d = 0; d < Dim; ++d) {
+        cur[d][id] = quantise(slot.values[d][i] + halfExtent[d], posScale[d],
+                              config.posBits);
+        cur[Dim + d][id] =
+            quantise(slot.values[Dim + d][i] + config.maxSpeed, velScale,
+                     config.velBits);
+      }
+      cur[columns][id] =
+          quantise(slot.values[columns][i], posScale[0], config.posBits);
+    }
+
+    // a delta against an id that was empty, or is empty now, means nothing
+    const bool keyframe =
+        frame % header.keyframeInterval == 0 || occupied != lastOccupied;
+    const int streams = keyframe ? columns + 1 : columns;
+    payload.assign(streams * sizeof(uint64_t), 0);
+    for (int c = 0; c < streams; ++c) {
+      encodeTrajectoryColumn(cur[c], keyframe ? nullptr : &prev[c], payload);
+      const uint64_t end = payload.size();
+      std::memcpy(payload.data() + c * sizeof(uint64_t), &end, sizeof(end));
+    }
+
+    TrajectoryFrameHeader fh{slot.step, static_cast<uint32_t>(n),
+                             keyframe ? 1u : 0u, payload.size()};
+    std::fwrite(&fh, sizeof(fh), 1, file);
+    std::fwrite(payload.data(), 1, payload.size(), file);
+    index.push_back(offset);
+    offset += sizeof(fh) + payload.size();
+
+    for (int c = 0; c < columns; ++c) {
+      prev[c].swap(cur[c]);
+    }
+    occupied.swap(lastOccupied);
+    ++frame;
+    written.fetch_add(1, std::memory_order_relaxed);
+    payloadBytes.fetch_add(sizeof(fh) + payload.size(),
+                           std::memory_order_relaxed);
+    ballFrames.fetch_add(slot.id.size(), std::memory_order_relaxed);
+  }
+};
+
+// Memory mapped trajectory with random access. seek() decodes from the
+// nearest keyframe at or before the target, stepping one frame forward only
+// decodes that frame's deltas. Inside the current keyframe interval every
+// waypointSpacing-th decoded frame is kept, so scrubbing backwards replays
+// at most waypointSpacing - 1 deltas instead of the whole interval.
+template <int Dim, typename Real> class TrajectoryReader {
+public:
+  static constexpr int columns = 2 * Dim;
+
+  explicit TrajectoryReader(const std::string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("cannot open trajectory " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 ||
+        static_cast<size_t>(st.st_size) < sizeof(TrajectoryHeader)) {
+      ::close(fd);
+      throw std::runtime_error("trajectory too short: " + path);
+    }
+    bytes = static_cast<size_t>(st.st_size);
+    base = static_cast<const uint8_t *>(
+        mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0));
+    ::close(fd);
+    if (base == MAP_FAILED) {
+      throw std::runtime_error("cannot map trajectory " + path);
+    }
+    std::memcpy(&header, base, sizeof(header));
+    if (header.magic != trajectoryMagic ||
+        header.version != trajectoryVersion || header.dim != Dim ||
+        !validTrajectoryBits(header.posBits) ||
+        !validTrajectoryBits(header.velBits)) {
+      munmap(const_cast<uint8_t *>(base), bytes);
+      throw std::runtime_error("not a " + std::to_string(Dim) +
+                               "D trajectory: " + path);
+    }
+    try {
+      buildIndex();
+    } catch (const std::runtime_error &e) {
+      munmap(const_cast<uint8_t *>(base), bytes);
+      throw std::runtime_error(std::string(e.what()) + ": " + path);
+    }
+    for (int d = 0; d < Dim; ++d) {
+      posStep[d] = 2.0 * header.halfExtent[d] / ((1u << header.posBits) - 1);
+    }
+    velStep = 2.0 * header.maxSpeed / ((1u << header.velBits) - 1);
+  }
+
+  ~TrajectoryReader() { munmap(const_cast<uint8_t *>(base), bytes); }
+
+  TrajectoryReader(const TrajectoryReader &) = delete;
+  TrajectoryReader &operator=(const TrajectoryReader &) = delete;
+
+  const TrajectoryHeader &info() const { return header; }
+  size_t frameCount() const { return frames.size(); }
+  uint64_t step(size_t k) const { return frameAt(k).step; }
+  size_t current() const { return decoded; }
+  size_t ballCount() const { return values[0].size(); }
+
+  void seek(JobSystem &jobs, size_t k) {
+    k = std::min(k, frames.size() - 1);
+    if (k == decoded) {
+      return;
+    }
+    size_t from = k;
+    if (decoded == none || k != decoded + 1) {
+      while (from > 0 && !frameAt(from).keyframe) {
+        --from;
+      }
+      if (!waypoints.empty() && waypoints[0].frame == from) {
+        const Waypoint *start = &waypoints[0];
+        for (const Waypoint &w : waypoints) {
+          if (w.frame <= k) {
+            start = &w;
+          }
+        }
+        jobs.parallelFor(0, columns + 1, 1, [&](size_t b, size_t e, size_t) {
+          for (size_t c = b; c < e; ++c) {
+            values[c] = start->values[c];
+          }
+        });
+        from = start->frame + 1;
+      }
+    }
+    for (size_t f = from; f <= k; ++f) {
+      decodeFrame(jobs, f);
+    }
+    decoded = k;
+  }
+
+  // memory against backward seek cost, 0 keeps only keyframes
+  void setWaypointSpacing(size_t frames) {
+    waypointSpacing = frames;
+    waypoints.clear();
+  }
+
+  // dequantised values of the decoded frame, ball i is id i
+  Real pos(int d, size_t i) const {
+    return static_cast<Real>(values[d][i] * posStep[d] -
+                             header.halfExtent[d]);
+  }
+  Real vel(int d, size_t i) const {
+    return static_cast<Real>(values[Dim + d][i] * velStep - header.maxSpeed);
+  }
+  Real radius(size_t i) const {
+    return static_cast<Real>(values[columns][i] * posStep[0]);
+  }
+
+  // the decoded frame as a state in id order, mass is not recorded and an
+  // id that had no ball comes out with radius 0
+  void fill(JobSystem &jobs, ParticleState<Dim, Real> &s) const {
+    const size_t n = ballCount();
+    for (int d = 0; d < Dim; ++d) {
+      s.pos[d].resize(n);
+      s.vel[d].resize(n);
+    }
+    s.radius.resize(n);
+    s.mass.assign(n, 0);
+    s.id.resize(n);
+    jobs.parallelFor(0, n, 16384, [&](size_t b, size_t e, size_t) {
+      for (size_t i = b; i < e; ++i) {
+        for (int d = 0; d < Dim; ++d) {
+          s.pos[d][i] = pos(d, i);
+          s.vel[d][i] = vel(d, i);
+        }
+        s.radius[i] = radius(i);
+        s.id[i] = static_cast<uint32_t>(i);
+      }
+    });
+  }
+
+private:
+  static constexpr size_t none = ~size_t(0);
+
+  const uint8_t *base{nullptr};
+  size_t bytes{0};
+  TrajectoryHeader header;
+  std::vector<uint64_t> frames;
+  std::vector<uint32_t> values[columns + 1];
+  size_t decoded{none};
+
+  // decoded frames of the current keyframe interval, keyframe first
+  struct Waypoint {
+    size_t frame;
+    std::vector<uint32_t> values[columns + 1];
+  };
+  std::vector<Waypoint> waypoints;
+  size_t waypointSpacing{8};
+  double posStep[Dim]{};
+  double velStep{0.0};
+
+  const TrajectoryFrameHeader &frameAt(size_t k) const {
+    return *reinterpret_cast<const TrajectoryFrameHeader *>(base + frames[k]);
+  }
+
+  void decodeFrame(JobSystem &jobs, size_t f) {
+    const TrajectoryFrameHeader &fh = frameAt(f);
+    const uint8_t *payload = base + frames[f] + sizeof(fh);
+    const bool keyframe = fh.keyframe != 0;
+    const int streams = keyframe ? columns + 1 : columns;
+    jobs.parallelFor(0, streams, 1, [&](size_t b, size_t e, size_t) {
+      for (size_t c = b; c < e; ++c) {
+        uint64_t begin = streams * sizeof(uint64_t), end = 0;
+        if (c > 0) {
+          std::memcpy(&begin, payload + (c - 1) * sizeof(uint64_t), 8);
+        }
+        std::memcpy(&end, payload + c * sizeof(uint64_t), 8);
+        decodeTrajectoryColumn(payload + begin, end - begin, keyframe,
+                               values[c], fh.count);
+      }
+    });
+    keepWaypoint(jobs, f, keyframe);
+  }
+
+  void keepWaypoint(JobSystem &jobs, size_t f, bool keyframe) {
+    if (keyframe) {
+      waypoints.resize(1);
+    } else if (waypoints.empty() || waypointSpacing == 0 ||
+               (f - waypoints[0].frame) % waypointSpacing != 0 ||
+               waypoints.back().frame >= f) {
+      return;
+    } else {
+      waypoints.emplace_back();
+    }
+    Waypoint &w = waypoints.back();
+    w.frame = f;
+    jobs.parallelFor(0, columns + 1, 1, [&](size_t b, size_t e, size_t) {
+      for (size_t c = b; c < e; ++c) {
+        w.values[c] = values[c];
+      }
+    });
+  }
+
+  void buildIndex() {
+    TrajectoryFooter footer{};
+    if (bytes >= sizeof(header) + sizeof(footer)) {
+      std::memcpy(&footer, base + bytes - sizeof(footer), sizeof(footer));
+    }
+    if (footer.magic == trajectoryMagic &&
+        footer.indexOffset + footer.frameCount * sizeof(uint64_t) +
+                sizeof(footer) ==
+            bytes) {
+      frames.resize(footer.frameCount);
+      std::memcpy(frames.data(), base + footer.indexOffset,
+                  frames.size() * sizeof(uint64_t));
+    } else {
+      // no index, the recorder did not close cleanly
+      uint64_t at = sizeof(header);
+      while (at + sizeof(TrajectoryFrameHeader) <= bytes) {
+        TrajectoryFrameHeader fh;
+        std::memcpy(&fh, base + at, sizeof(fh));
+        if (at + sizeof(fh) + fh.payloadBytes > bytes) {
+          break;
+        }
+        frames.push_back(at);
+        at += sizeof(fh) + fh.payloadBytes;
+      }
+    }
+    // a clean close with nothing recorded too, seek() needs a frame
+    if (frames.empty()) {
+      throw std::runtime_error("trajectory has no frames");
+    }
+  }
+};
@@ -0,0 +1,31 @@
+#pragma once
+// Include after the app's glad.h and <GLFW/glfw3.h>, like shaderProgram.hpp.
+#include "../../physicsCore/includes/replay.hpp"
+
+// Replay controls shared by the apps: P toggles play, HOME and END jump to
+// the first and last frame, LEFT and RIGHT scrub. One per clock, it
+// remembers whether P was already down.
+class ReplayKeys {
+public:
+  // reads the keys, advances the clock and returns the frame to show
+  size_t update(GLFWwindow *w, ReplayClock &clock, double dt,
+                size_t frameCount) {
+    const bool pause = glfwGetKey(w, GLFW_KEY_P) == GLFW_PRESS;
+    if (pause && !pauseHeld) {
+      clock.playing = !clock.playing;
+    }
+    pauseHeld = pause;
+    if (glfwGetKey(w, GLFW_KEY_HOME) == GLFW_PRESS) {
+      clock.frame = 0.0;
+    }
+    if (glfwGetKey(w, GLFW_KEY_END) == GLFW_PRESS) {
+      clock.frame = static_cast<double>(frameCount - 1);
+    }
+    const int scrub = (glfwGetKey(w, GLFW_KEY_RIGHT) == GLFW_PRESS) -
+                      (glfwGetKey(w, GLFW_KEY_LEFT) == GLFW_PRESS);
+    return clock.advance(dt, scrub, frameCount);
+  }
+
+private:
+  bool pauseHeld{false};
+};
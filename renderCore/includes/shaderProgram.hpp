@@ -0,0 +1,448 @@
+#pragma once
+// Program building shared by the apps: the binary cache and ShaderBuilder.
+// Include it after the app's glad.h and <GLFW/glfw3.h>, the GL loader stays
+// with each app. The apps' Shader adds the glm typed uniform setters.
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// Lets programs build while the caller carries on with startup.
+// With KHR/ARB_parallel_shader_compile the driver compiles on its own threads
+// and glLinkProgram returns at once. Otherwise programs are built on a worker
+// thread that owns a hidden context sharing objects with the main one. Only
+// one builder exists at a time; Shaders created while none exists, or after
+// it is gone, build synchronously. Create it after the Window and before the
+// Shaders so it outlives them.
+class ShaderBuilder {
+public:
+  enum class Mode { Inline, Parallel, Threaded };
+
+  explicit ShaderBuilder(GLFWwindow *mainWindow) {
+    if (glfwExtensionSupported("GL_KHR_parallel_shader_compile") ||
+        glfwExtensionSupported("GL_ARB_parallel_shader_compile")) {
+      typedef void(APIENTRYP MaxThreadsProc)(GLuint count);
+      auto maxThreads = reinterpret_cast<MaxThreadsProc>(
+          glfwGetProcAddress("glMaxShaderCompilerThreadsKHR"));
+      if (!maxThreads) {
+        maxThreads = reinterpret_cast<MaxThreadsProc>(
+            glfwGetProcAddress("glMaxShaderCompilerThreadsARB"));
+      }
+      if (maxThreads) {
+        maxThreads(0xFFFFFFFFu); // as many as the driver likes
+      }
+      mode = Mode::Parallel;
+    } else {
+      glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+      context = glfwCreateWindow(1, 1, "", nullptr, mainWindow);
+      glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+      if (context) {
+        mode = Mode::Threaded;
+        worker = std::thread([this] { run(); });
+      }
+    }
+    current() = this;
+  }
+
+  ~ShaderBuilder() {
+    current() = nullptr;
+    if (worker.joinable()) {
+      {
+        std::lock_guard<std::mutex> lock(m);
+        stopping = true;
+      }
+      wake.notify_one();
+      worker.join();
+    }
+    if (context) {
+      glfwDestroyWindow(context);
+    }
+  }
+
+  ShaderBuilder(const ShaderBuilder &) = delete;
+  ShaderBuilder &operator=(const ShaderBuilder &) = delete;
+
+  static Mode activeMode() { return current() ? current()->mode : Mode::Inline; }
+
+  static const char *modeName(Mode mode) {
+    switch (mode) {
+    case Mode::Parallel:
+      return "driver parallel compile";
+    case Mode::Threaded:
+      return "shared context thread";
+    default:
+      return "synchronous";
+    }
+  }
+
+  // runs job on the worker thread, only valid in Threaded mode
+  static void submit(std::function<void()> job) {
+    ShaderBuilder *b = current();
+    {
+      std::lock_guard<std::mutex> lock(b->m);
+      b->jobs.push_back(std::move(job));
+    }
+    b->wake.notify_one();
+  }
+
+private:
+  Mode mode{Mode::Inline};
+  GLFWwindow *context{nullptr};
+  std::thread worker;
+  std::mutex m;
+  std::condition_variable wake;
+  std::deque<std::function<void()>> jobs;
+  bool stopping{false};
+
+  static ShaderBuilder *&current() {
+    static ShaderBuilder *builder = nullptr;
+    return builder;
+  }
+
+  void run() {
+    glfwMakeContextCurrent(context);
+    for (;;) {
+      std::function<void()> job;
+      {
+        std::unique_lock<std::mutex> lock(m);
+        wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+        if (jobs.empty()) {
+          break;
+        }
+        job = std::move(jobs.front());
+        jobs.pop_front();
+      }
+      job();
+    }
+    glfwMakeContextCurrent(nullptr);
+  }
+};
+
+// Linked programs are cached in shaderCache/ as driver binaries
+// (glGetProgramBinary), keyed by a hash of both sources and the GL vendor,
+// renderer and version strings. A missing, stale or rejected binary falls
+// back to a normal compile, which refreshes the cache. Set NO_SHADER_CACHE
+// to always compile, e.g. to compare startup times.
+// Construction only submits the build; the link result is first waited for
+// in use(), so the caller can do other startup work in between.
+class ShaderProgram {
+public:
+  GLuint ID{0};
+  bool fromCache{false};
+  double buildMs{0.0}; // construction until ready, waiting included
+
+  ShaderProgram(const char *vertexPath, const char *fragmentPath)
+      : created(std::chrono::steady_clock::now()) {
+    std::ifstream vertexFile(vertexPath), fragFile(fragmentPath);
+    if (!vertexFile || !fragFile) {
+      std::cerr << "Failed to open shader file:" << vertexPath << "or"
+                << fragmentPath << std::endl;
+      ID = 0;
+      return;
+    }
+    std::stringstream vStream, fStream;
+    vStream << vertexFile.rdbuf();
+    fStream << fragFile.rdbuf();
+
+    std::string vCode = vStream.str();
+    std::string fCode = fStream.str();
+
+    switch (ShaderBuilder::activeMode()) {
+    case ShaderBuilder::Mode::Threaded: {
+      auto promise = std::make_shared<std::promise<Built>>();
+      threaded = promise->get_future();
+      ShaderBuilder::submit([promise, vCode, fCode] {
+        Built built = build(vCode, fCode);
+        glFinish(); // complete before the main context touches it
+        promise->set_value(built);
+      });
+      state = State::Threaded;
+      break;
+    }
+    case ShaderBuilder::Mode::Parallel:
+      cacheFile = binaryCacheEnabled() ? cachePath(vCode, fCode) : "";
+      ID = cacheFile.empty() ? 0 : loadBinary(cacheFile);
+      fromCache = ID != 0;
+      if (!ID) {
+        ID = submitProgram(vCode.c_str(), fCode.c_str(), !cacheFile.empty(),
+                           vs, fs);
+        state = State::Linking;
+      } else {
+        finish(0.0);
+      }
+      break;
+    default: {
+      Built built = build(vCode, fCode);
+      ID = built.id;
+      fromCache = built.fromCache;
+      finish(0.0);
+    }
+    }
+  }
+
+  ShaderProgram(const ShaderProgram &) = delete;
+  ShaderProgram &operator=(const ShaderProgram &) = delete;
+
+  // true once use() would not block
+  bool linked() const {
+    switch (state) {
+    case State::Threaded:
+      return threaded.wait_for(std::chrono::seconds(0)) ==
+             std::future_status::ready;
+    case State::Linking: {
+      GLint done = GL_TRUE;
+      glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &done);
+      return done == GL_TRUE;
+    }
+    default:
+      return true;
+    }
+  }
+
+  // waits for a pending build, reports errors and fills the binary cache
+  void ready() {
+    if (state == State::Ready) {
+      return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    if (state == State::Threaded) {
+      Built built = threaded.get();
+      ID = built.id;
+      fromCache = built.fromCache;
+    } else {
+      ID = finishProgram(ID, vs, fs);
+      if (ID && !cacheFile.empty()) {
+        saveBinary(ID, cacheFile);
+      }
+    }
+    finish(std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+               .count());
+  }
+
+  // time the main thread spent blocked on builds so far
+  static void reportStartup(std::ostream &out) {
+    out << "shaders (" << ShaderBuilder::modeName(ShaderBuilder::activeMode())
+        << "): " << programs << " programs ready, main thread blocked "
+        << blockedMs << " ms, " << cachedPrograms << " from the binary cache"
+        << (cacheDisabled() ? " (cache off)" : "") << std::endl;
+  }
+
+  void use() {
+    ready();
+    glUseProgram(ID);
+  }
+  // I think it might be better to not fetch location each call when setting in
+  // while loop so to fix that have a func. to fetch the location only and only
+  // fetch one in main. I will implement it later
+  void setInt(const std::string &name, int value) const {
+    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+  }
+  void setFloat(const std::string &name, float value) const {
+    glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+  }
+  void setMat4(const std::string &name, const float *mat) const {
+    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE,
+                       mat);
+  }
+  ~ShaderProgram() {
+    if (state == State::Threaded) {
+      ready(); // the worker may still be writing ID
+    }
+    if (ID) {
+      glDeleteProgram(ID);
+    }
+  }
+
+private:
+  enum class State { Ready, Linking, Threaded };
+  struct Built {
+    GLuint id;
+    bool fromCache;
+  };
+
+  State state{State::Ready};
+  std::chrono::steady_clock::time_point created;
+  std::future<Built> threaded;
+  std::string cacheFile;
+  GLuint vs{0}, fs{0};
+
+  inline static double blockedMs = 0.0;
+  inline static int programs = 0;
+  inline static int cachedPrograms = 0;
+
+  static constexpr const char *cacheDir = "shaderCache";
+  static constexpr uint32_t cacheMagic = 0x42505347; // "GSPB"
+
+  void finish(double waitedMs) {
+    state = State::Ready;
+    buildMs = std::chrono::duration<double, std::milli>(
+                  std::chrono::steady_clock::now() - created)
+                  .count();
+    blockedMs += waitedMs;
+    ++programs;
+    cachedPrograms += fromCache;
+  }
+
+  // the whole build on the calling thread, cache lookup included
+  static Built build(const std::string &vCode, const std::string &fCode) {
+    const bool cache = binaryCacheEnabled();
+    const std::string path = cache ? cachePath(vCode, fCode) : std::string();
+    GLuint id = cache ? loadBinary(path) : 0;
+    if (id) {
+      return {id, true};
+    }
+    GLuint vs = 0, fs = 0;
+    id = finishProgram(
+        submitProgram(vCode.c_str(), fCode.c_str(), cache, vs, fs), vs, fs);
+    if (id && cache) {
+      saveBinary(id, path);
+    }
+    return {id, false};
+  }
+
+  static bool cacheDisabled() { return std::getenv("NO_SHADER_CACHE"); }
+
+  // needs GL 4.1 or ARB_get_program_binary and at least one binary format
+  static bool binaryCacheEnabled() {
+    if (cacheDisabled() || !glGetProgramBinary || !glProgramBinary ||
+        !glProgramParameteri) {
+      return false;
+    }
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+  }
+
+  static std::string cachePath(const std::string &vCode,
+                               const std::string &fCode) {
+    uint64_t h = 14695981039346656037ull;
+    auto mix = [&h](const char *text) {
+      for (; text && *text; ++text) {
+        h = (h ^ static_cast<unsigned char>(*text)) * 1099511628211ull;
+      }
+      h = (h ^ 0xff) * 1099511628211ull; // keeps "ab"+"c" apart from "a"+"bc"
+    };
+    mix(vCode.c_str());
+    mix(fCode.c_str());
+    mix(reinterpret_cast<const char *>(glGetString(GL_VENDOR)));
+    mix(reinterpret_cast<const char *>(glGetString(GL_RENDERER)));
+    mix(reinterpret_cast<const char *>(glGetString(GL_VERSION)));
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin",
+                  static_cast<unsigned long long>(h));
+    return std::string(cacheDir) + "/" + name;
+  }
+
+  // file layout: magic, binary format, byte count, driver binary
+  static GLuint loadBinary(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    uint32_t header[3] = {0, 0, 0};
+    if (!file.read(reinterpret_cast<char *>(header), sizeof(header)) ||
+        header[0] != cacheMagic) {
+      return 0;
+    }
+    std::vector<char> binary(header[2]);
+    if (!file.read(binary.data(), binary.size())) {
+      return 0;
+    }
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, header[1], binary.data(),
+                    static_cast<GLsizei>(binary.size()));
+    GLint success = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+      glDeleteProgram(program); // driver changed under the same strings
+      return 0;
+    }
+    return program;
+  }
+
+  static void saveBinary(GLuint program, const std::string &path) {
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+      return;
+    }
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, nullptr, &format, binary.data());
+    std::error_code ignored;
+    std::filesystem::create_directories(cacheDir, ignored);
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    uint32_t header[3] = {cacheMagic, format, static_cast<uint32_t>(length)};
+    file.write(reinterpret_cast<const char *>(header), sizeof(header));
+    file.write(binary.data(), binary.size());
+  }
+
+  static GLuint compileShader(GLenum type, const char *src) {
+    GLuint id = glCreateShader(type);
+    glShaderSource(id, 1, &src, nullptr);
+    glCompileShader(id);
+    return id;
+  }
+
+  // issues compile and link without asking for any status, so a driver
+  // with parallel compile can return straight away
+  static GLuint submitProgram(const char *vCode, const char *fCode,
+                              bool retrievable, GLuint &vs, GLuint &fs) {
+    vs = compileShader(GL_VERTEX_SHADER, vCode);
+    fs = compileShader(GL_FRAGMENT_SHADER, fCode);
+
+    GLuint program = glCreateProgram();
+    if (retrievable) {
+      glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    glAttachShader(program, vs);
+    glAttachShader(program, fs);
+    glLinkProgram(program);
+    return program;
+  }
+
+  static bool compiled(GLuint shader) {
+    GLint success;
+    char infoLog[512];
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+      glGetShaderInfoLog(shader, 512, nullptr, infoLog);
+      std::cerr << "shader compile error:" << infoLog << std::endl;
+    }
+    return success;
+  }
+
+  // first status query, blocks until the link is done
+  static GLuint finishProgram(GLuint program, GLuint vs, GLuint fs) {
+    GLint success;
+    char infoLog[512];
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+      compiled(vs);
+      compiled(fs);
+      glGetProgramInfoLog(program, 512, nullptr, infoLog);
+      std::cerr << "Program link error: " << infoLog << std::endl;
+      glDeleteProgram(program);
+      program = 0;
+    }
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+
+    return program;
+  }
+};